@@ -4,6 +4,13 @@
 #include "go.h"
 #include "storage_manager.h"
 #include "eval.h"
+#include "best.h"
+#include "statistics.h"
+
+#ifdef PARALLEL_ALPHA_BETA
+#include <tbb/task_group.h>
+#include <tbb/spin_mutex.h>
+#endif
 
 class Agent {
 protected:
@@ -92,6 +99,32 @@ public:
 	}
 };
 
+const static string PROBCUT_FILENAME = "probcut" + HELPER_FILE_EXTENSION;
+
+//ProbCut reduction and min remaining depth, written by the calibration in interaction.cpp, a reduction of 0 disables it
+class ProbCutParameters {
+public:
+	Step Reduction = 0;
+	Step MinDepth = 0;
+
+	//the parameters are kept if there is no valid file
+	bool Load(const string& filename = PROBCUT_FILENAME) {
+		ifstream file(filename);
+		int reduction, minDepth;
+		if (!(file >> reduction >> minDepth) || reduction < 0 || minDepth < 0) {
+			return false;
+		}
+		Reduction = static_cast<Step>(reduction);
+		MinDepth = static_cast<Step>(minDepth);
+		return true;
+	}
+
+	void Save(const string& filename = PROBCUT_FILENAME) const {
+		ofstream file(filename);
+		file << static_cast<int>(Reduction) << " " << static_cast<int>(MinDepth) << endl;
+	}
+};
+
 template<typename E>
 class AlphaBetaAgent : public Agent {
 protected:
@@ -102,85 +135,356 @@ protected:
 		Limit() : Evaluation() {}
 		Limit(const E& _evaluation) : HasValue(true), Evaluation(_evaluation) {}
 	};
+
+	enum class Bound : unsigned char {//of a value searched with a window, from the view of me
+		Exact,
+		Lower,
+		Upper,
+	};
 private:
 	const ActionSequence& actionSequence;
+	StatisticsCollector statistics;
 
 	inline static bool GameFinished(const Step finishedStep, const bool isFirstStep, const bool consecutivePass) {
 		return finishedStep == MAX_STEP || (!isFirstStep && consecutivePass);
 	}
 #ifdef SEARCH_MODE
-	const bool& Token;
+	const atomic<bool>& Token;
+#else
+	const atomic<bool>* stopToken = nullptr;
+#endif
+
+	inline bool Stopped() const {
+#ifdef SEARCH_MODE
+		auto stopped = Token.load(std::memory_order_relaxed);
+#else
+		auto stopped = stopToken != nullptr && stopToken->load(std::memory_order_relaxed);
+#endif
+#ifdef PARALLEL_ALPHA_BETA
+		stopped = stopped || tbb::is_current_task_group_canceling();//an elder brother found a cut-off
 #endif
+		return stopped;
+	}
+
+	inline static bool Update(const bool max, const Limit& value, const bool consecutivePass, Limit& best, bool& bestIsConsecutivePass, Limit& alpha, Limit& beta) {//return true if cut-off
+		auto cmp = best.Evaluation.Compare(value.Evaluation);
+		auto updateBest = !best.HasValue || (max ? cmp < 0 : cmp > 0);
+		if (updateBest) {
+			best.Evaluation = value.Evaluation;
+			best.HasValue = true;
+			bestIsConsecutivePass = consecutivePass;
+		}
+		if (max) {
+			if (!alpha.HasValue || alpha.Evaluation.Compare(best.Evaluation) < 0) {
+				alpha = best;
+			}
+		} else {
+			if (!beta.HasValue || beta.Evaluation.Compare(best.Evaluation) > 0) {
+				beta = best;
+			}
+		}
+		return beta.HasValue && alpha.HasValue && beta.Evaluation.Compare(alpha.Evaluation) <= 0;
+	}
+
+	inline static bool Improves(const bool max, const Limit& value, const Limit& alpha, const Limit& beta) {
+		if (!value.HasValue) {
+			return false;
+		}
+		if (max) {
+			return !alpha.HasValue || alpha.Evaluation.Compare(value.Evaluation) < 0;
+		} else {
+			return !beta.HasValue || beta.Evaluation.Compare(value.Evaluation) > 0;
+		}
+	}
+
+	inline bool DepthLimited() const {
+		return DepthLimit != std::numeric_limits<Step>::max();
+	}
+
+	//no value is better, a window bounded by it can only fail low
+	template <typename T>
+	inline static bool Highest(const T&) {
+		return false;
+	}
+
+	inline static bool Highest(const WinEval& e) {
+		return e.GoodEnough();
+	}
+
+	//no value is worse once the search is not depth limited, a value failing low on it is exact
+	template <typename T>
+	inline static bool Lowest(const T&) {
+		return false;
+	}
+
+	inline static bool Lowest(const WinEval& e) {
+		return e.Initialized() && !e.Win();
+	}
+
+	inline int Reduction(const int depth, const size_t index, const Board currentBoard, const std::pair<Action, Board>& action) const {
+		if (LateMoveIndex == 0 || index < LateMoveIndex || action.first == Action::Pass || !DepthLimited() || depth + 1 + LateMoveReduction >= DepthLimit) {
+			return 0;
+		}
+		if (__builtin_popcountll(Field::OccupyField(action.second)) <= __builtin_popcountll(Field::OccupyField(currentBoard))) {//never reduce captures
+			return 0;
+		}
+		return LateMoveReduction;
+	}
+
+	//actions which capture, or extend a group in atari
+	inline static bool Tactical(const Board currentBoard, const Board escapes, const std::pair<Action, Board>& action) {
+		if (action.first == Action::Pass) {
+			return false;
+		}
+		return (static_cast<Board>(action.first) & escapes) != 0 || __builtin_popcountll(Field::OccupyField(action.second)) <= __builtin_popcountll(Field::OccupyField(currentBoard));
+	}
+
+	inline static Board Escapes(const Player player, const Board currentBoard) {
+		auto own = BitBoardUtil::Stones(currentBoard, player);
+		const auto empty = ~(Field::OccupyField(currentBoard) >> OCCUPY_SHIFT) & BIT_FULL;
+		Board result = EMPTY_BOARD;
+		while (own != 0) {
+			const auto group = BitBoardUtil::Flood(own & (~own + 1), own);
+			own &= ~group;
+			const auto liberties = BitBoardUtil::Liberties(group, empty);
+			if (__builtin_popcountll(liberties) == 1) {
+				result |= liberties;
+			}
+		}
+		return result;
+	}
+
+	//beyond the depth limit, only tactical actions are searched until the position is quiet or the budget runs out
+	//the player to move may always stop with the local evaluation
+	Limit Quiescence(
+		const bool max, const Player me, const Player opponent,
+		const Step finishedStep, const Board lastBoard, const Board currentBoard,
+		const vector<std::pair<Action, Board>>& allActions,
+		Limit alpha, Limit beta, int& budget)
+	{
+		statistics.Local().Nodes++;
+		const auto localEvaluation = E(false, finishedStep, me, currentBoard);
+		Limit best;
+		auto bestIsConsecutivePass = false;
+		if (Update(max, Limit(localEvaluation), false, best, bestIsConsecutivePass, alpha, beta) || budget <= 0) {
+			return best;
+		}
+		const auto player = max ? me : opponent;
+		const auto escapes = Escapes(player, currentBoard);
+		const Step nextFinishedStep = finishedStep + 1;
+		auto searched = false;
+		for (const auto& action : allActions) {
+			if (budget <= 0 || Stopped()) {
+				break;
+			}
+			if (!Tactical(currentBoard, escapes, action)) {
+				continue;
+			}
+			budget--;
+			Limit value;
+			if (nextFinishedStep == MAX_STEP) {
+				value = Limit(E(true, nextFinishedStep, me, action.second));
+			} else {
+				const auto childActions = LegalActionIterator::ListAll(max ? opponent : me, currentBoard, action.second, false, &actionSequence);
+				value = Quiescence(!max, me, opponent, nextFinishedStep, currentBoard, action.second, childActions, alpha, beta, budget);
+			}
+			const auto old = best.Evaluation;
+			const auto cut = Update(max, value, false, best, bestIsConsecutivePass, alpha, beta);
+			searched = searched || best.Evaluation.Compare(old) != 0;
+			if (cut) {
+				break;
+			}
+		}
+		if (searched) {
+			best.Evaluation.Push(localEvaluation);
+		}
+		return best;
+	}
+
 	Limit SearchMiniMax(
 		const bool max, const int depth,
 		const Player me, const Player opponent, 
 		const Step finishedStep, const bool isFirstStep, 
 		const Board lastBoard, const Board currentBoard, 
 		const bool getThisByOpponentPass, const bool consecutivePass, 
-		Limit alpha, Limit beta) 
+		Limit alpha, Limit beta,
+		const bool probed = false)//missed in the store by the parent already
 	{
 		assert(!alpha.HasValue || !beta.HasValue || alpha.Evaluation.Compare(beta.Evaluation) == -1);
-#ifdef SEARCH_MODE
-		if (Token) {
+		if (Stopped()) {
 			return Limit();
 		}
-#endif
+		auto& counter = statistics.Local();
+		counter.Node(depth);
 		if (GameFinished(finishedStep, isFirstStep, consecutivePass)) {//check terminate state first, for consecutivePass
+			counter.TwoPassTerminations += finishedStep != MAX_STEP;
 			return Limit(E(true, finishedStep, me, currentBoard));
 		}
 		bool hasKoAction;
-		const auto allActions = LegalActionIterator::ListAll(max ? me : opponent, lastBoard, currentBoard, isFirstStep, &actionSequence, hasKoAction);
-		if (!hasKoAction && !getThisByOpponentPass) {
+		Action koAction;
+		const auto allActions = LegalActionIterator::ListAll(max ? me : opponent, lastBoard, currentBoard, isFirstStep, &actionSequence, hasKoAction, koAction);
+		const auto key = PositionKey::Make(currentBoard, koAction, getThisByOpponentPass);
+		if (!probed && (ExtendedKeys || (!hasKoAction && !getThisByOpponentPass))) {
 			E getEval;
-			if (Get(finishedStep, currentBoard, getEval)) {
+			const auto hit = Get(finishedStep, key, getEval);
+			counter.Probe(hit);
+			if (hit) {
 				return Limit(getEval);
 			}
 		}
+		const auto plain = BoundedTable && !hasKoAction && !getThisByOpponentPass;
+		const auto windowAlpha = plain ? alpha : Limit();
+		const auto windowBeta = plain ? beta : Limit();
+		if (plain) {
+			E boundEval;
+			Bound bound;
+			if (GetBound(finishedStep, currentBoard, depth, boundEval, bound)
+				&& (bound == Bound::Exact
+					|| (bound == Bound::Lower && beta.HasValue && beta.Evaluation.Compare(boundEval) <= 0)
+					|| (bound == Bound::Upper && alpha.HasValue && alpha.Evaluation.Compare(boundEval) >= 0))) {
+				return Limit(boundEval);
+			}
+		}
 		auto localEvaluation = E(false, finishedStep, me, currentBoard);
 		if (depth >= DepthLimit && lastBoard != currentBoard) {
+			if (QuiescenceBudget > 0) {
+				auto budget = QuiescenceBudget;
+				return Quiescence(max, me, opponent, finishedStep, lastBoard, currentBoard, allActions, alpha, beta, budget);
+			}
 			return Limit(localEvaluation);
 		}
+		if (ProbCutReduction > 0 && DepthLimited() && DepthLimit - depth >= ProbCutMinDepth && (max ? beta.HasValue : alpha.HasValue)) {//trust a shallow search if it already fails high
+			auto shallow = SearchMiniMax(max, depth + ProbCutReduction, me, opponent, finishedStep, isFirstStep, lastBoard, currentBoard, getThisByOpponentPass, consecutivePass, alpha, beta);
+			if (shallow.HasValue && (max ? beta.Evaluation.Compare(shallow.Evaluation) <= 0 : alpha.Evaluation.Compare(shallow.Evaluation) >= 0)) {
+				return shallow;
+			}
+		}
 		Limit best;
 		auto bestIsConsecutivePass = false;
 		const auto nextFinishedStep = finishedStep + 1;
 		bool unlimited = !alpha.HasValue && !beta.HasValue;//alpha and beta may be modified later, so judge here
-		for (const auto& action : allActions) {
-			const auto nextGetThisByOpponentPass = action.first == Action::Pass;
-			const auto nextConsecutivePass = getThisByOpponentPass && nextGetThisByOpponentPass;
-			auto value = SearchMiniMax(!max, depth + 1, me, opponent, nextFinishedStep, false, currentBoard, action.second, nextGetThisByOpponentPass, nextConsecutivePass, alpha, beta);
-			auto cmp = best.Evaluation.Compare(value.Evaluation);
-			auto updateBest = !best.HasValue || (max ? cmp < 0 : cmp > 0);
-			if (updateBest) {
-				best.Evaluation = value.Evaluation;
-				best.HasValue = true;
-				bestIsConsecutivePass = nextConsecutivePass;
-			}
-			if (max) {
-				if (!alpha.HasValue || alpha.Evaluation.Compare(best.Evaluation) < 0) {
-					alpha = best;
+		auto cut = false;
+		UINT32 missed = 0, found = 0;//children probed by the enhanced transposition cut-off by action index, a found one is already in best, so neither is probed again
+		if (EnhancedTranspositionCutOff && !unlimited && nextFinishedStep < MAX_STEP) {//a child found in the store gives the same value as searching it, so try all of them first
+			for (size_t i = 0; i < allActions.size(); i++) {
+				const auto& action = allActions[i];
+				if (action.first == Action::Pass || (action.second != currentBoard && __builtin_popcountll(Field::OccupyField(action.second)) == __builtin_popcountll(Field::OccupyField(currentBoard)))) {//lookups are skipped in these children
+					continue;
 				}
-			} else {
-				if (!beta.HasValue || beta.Evaluation.Compare(best.Evaluation) > 0) {
-					beta = best;
+				E getEval;
+				const auto hit = Get(nextFinishedStep, action.second, getEval);
+				counter.Probe(hit);
+				if (!hit) {
+					missed |= 1u << i;
+					continue;
+				}
+				found |= 1u << i;
+				if (Update(max, Limit(getEval), false, best, bestIsConsecutivePass, alpha, beta)) {
+					counter.Cut(false);
+					best.Evaluation.Push(localEvaluation);
+					return best;
 				}
 			}
-			if (beta.HasValue && alpha.HasValue && beta.Evaluation.Compare(alpha.Evaluation) <= 0) {
+		}
+		auto iter = allActions.begin();
+		auto searched = false;
+		for (; iter != allActions.end() && !cut; iter++) {
+#ifdef PARALLEL_ALPHA_BETA
+			if (depth < SplitDepth && searched) {//young brothers wait for the eldest one, children found by the enhanced transposition cut-off are not searched
 				break;
 			}
+#endif
+			const auto& action = *iter;
+			const auto index = iter - allActions.begin();
+			if ((found >> index) & 1) {
+				continue;
+			}
+			searched = true;
+			const auto probed = ((missed >> index) & 1) != 0;
+			const auto nextGetThisByOpponentPass = action.first == Action::Pass;
+			const auto nextConsecutivePass = getThisByOpponentPass && nextGetThisByOpponentPass;
+			const auto reduction = Reduction(depth, index, currentBoard, action);
+			auto value = SearchMiniMax(!max, depth + 1 + reduction, me, opponent, nextFinishedStep, false, currentBoard, action.second, nextGetThisByOpponentPass, nextConsecutivePass, alpha, beta, probed);
+			if (reduction > 0 && Improves(max, value, alpha, beta)) {//re-search with full depth
+				value = SearchMiniMax(!max, depth + 1, me, opponent, nextFinishedStep, false, currentBoard, action.second, nextGetThisByOpponentPass, nextConsecutivePass, alpha, beta, probed);
+			}
+			cut = Update(max, value, nextConsecutivePass, best, bestIsConsecutivePass, alpha, beta);
+		}
+		const auto firstMoveCut = cut && iter - allActions.begin() == 1;
+#ifdef PARALLEL_ALPHA_BETA
+		if (!cut && iter != allActions.end()) {
+			tbb::task_group group;
+			tbb::spin_mutex mutex;
+			for (; iter != allActions.end(); iter++) {
+				const auto action = *iter;
+				const size_t index = iter - allActions.begin();
+				if ((found >> index) & 1) {
+					continue;
+				}
+				group.run([&, action, index]() {
+					Limit a, b;
+					{
+						tbb::spin_mutex::scoped_lock l(mutex);
+						if (cut) {
+							return;
+						}
+						a = alpha;//window may be narrowed by brothers finished earlier
+						b = beta;
+					}
+					const auto nextGetThisByOpponentPass = action.first == Action::Pass;
+					const auto nextConsecutivePass = getThisByOpponentPass && nextGetThisByOpponentPass;
+					const auto reduction = Reduction(depth, index, currentBoard, action);
+					const auto probed = ((missed >> index) & 1) != 0;
+					auto value = SearchMiniMax(!max, depth + 1 + reduction, me, opponent, nextFinishedStep, false, currentBoard, action.second, nextGetThisByOpponentPass, nextConsecutivePass, a, b, probed);
+					if (reduction > 0 && Improves(max, value, a, b)) {
+						value = SearchMiniMax(!max, depth + 1, me, opponent, nextFinishedStep, false, currentBoard, action.second, nextGetThisByOpponentPass, nextConsecutivePass, a, b, probed);
+					}
+					tbb::spin_mutex::scoped_lock l(mutex);
+					if (!cut && Update(max, value, nextConsecutivePass, best, bestIsConsecutivePass, alpha, beta)) {
+						cut = true;
+						group.cancel();
+					}
+				});
+			}
+			group.wait();
 		}
-		best.Evaluation.Push(localEvaluation);
-		if (unlimited && !hasKoAction && !bestIsConsecutivePass
-#ifdef SEARCH_MODE
-			&& !Token
 #endif
-			) {
-			Set(finishedStep, currentBoard, best.Evaluation);
+		if (cut) {
+			counter.Cut(firstMoveCut);
+		}
+		best.Evaluation.Push(localEvaluation);
+		counter.KoBlockedStores += unlimited && hasKoAction && !ExtendedKeys;
+		if (unlimited && !Stopped()) {
+			if (!hasKoAction && !bestIsConsecutivePass) {
+				Set(finishedStep, currentBoard, best.Evaluation);
+			}
+			if (ExtendedKeys && key != currentBoard) {
+				Set(finishedStep, key, best.Evaluation);
+			}
+		}
+		if (plain && !bestIsConsecutivePass && best.HasValue && !Stopped()) {
+			auto bound = Bound::Exact;
+			if (windowBeta.HasValue && windowBeta.Evaluation.Compare(best.Evaluation) <= 0) {
+				bound = Bound::Lower;
+			} else if (windowAlpha.HasValue && windowAlpha.Evaluation.Compare(best.Evaluation) >= 0) {
+				bound = Bound::Upper;
+			}
+			SetBound(finishedStep, currentBoard, depth, best.Evaluation, bound);
 		}
 		return best;
 	}
 
 protected:
 	Step DepthLimit = std::numeric_limits<Step>::max();
+	Step SplitDepth = 0;//search young brothers in parallel above this depth, only with PARALLEL_ALPHA_BETA
+	Step LateMoveIndex = 0;//reduce actions from this index on, 0 to disable
+	Step LateMoveReduction = 1;
+	Step ProbCutReduction = 0;//depth reduction of the shallow search, 0 to disable
+	Step ProbCutMinDepth = 4;//only at nodes with at least this remaining depth
+	int QuiescenceBudget = 0;//nodes searched beyond each leaf, 0 to disable
+	bool EnhancedTranspositionCutOff = false;//look up all children before searching any
+	bool ExtendedKeys = false;//store ko and opponent passed positions with PositionKey, Get and Set may receive such keys
+	bool BoundedTable = false;//GetBound and SetBound are called at every node with its window
 
 	virtual void StepInit(const Step finishedStep, const Board board) {
 
@@ -193,11 +497,26 @@ protected:
 	virtual void Set(const Step finishedStep, const Board board, const E& evaluation) {
 
 	}
+
+	//results of every node with its window, for tables which keep bounds, depth is the one of the node in this search
+	virtual bool GetBound(const Step finishedStep, const Board board, const int depth, E& evaluation, Bound& bound) const {
+		return false;
+	}
+
+	virtual void SetBound(const Step finishedStep, const Board board, const int depth, const E& evaluation, const Bound bound) {
+
+	}
+
+#ifndef SEARCH_MODE
+	void SetStopToken(const atomic<bool>* token) {//results are not valid after stopped
+		stopToken = token;
+	}
+#endif
 public:
 
 	AlphaBetaAgent(
 #ifdef SEARCH_MODE
-		const bool& _token, 
+		const atomic<bool>& _token, 
 #endif
 		const ActionSequence& _actionSequence = DEFAULT_ACTION_SEQUENCE) : actionSequence(_actionSequence)
 #ifdef SEARCH_MODE
@@ -207,6 +526,9 @@ public:
 
 	pair<Action, E> Search(const Step finishedStep, const Board lastBoard, const Board currentBoard) {
 		StepInit(finishedStep, currentBoard);
+		statistics.Clear();
+		const auto start = high_resolution_clock::now();
+		statistics.Local().Node(0);
 
 		auto me = MyPlayer(finishedStep);
 		auto opponent = TurnUtil::Opponent(me);
@@ -220,28 +542,150 @@ public:
 		Limit best;
 		const auto allActions = AllActions(me, lastBoard, currentBoard, isFirstStep, &actionSequence);
 		const auto nextFinishedStep = finishedStep + 1;
-		for (const auto& action : allActions) {
-			const auto nextGetThisByPass = action.first == Action::Pass;
-			const auto nextConsecutivePass = (!isFirstStep && lastBoard == currentBoard) && nextGetThisByPass;
-			auto value = SearchMiniMax(false, depth + 1, me, opponent, nextFinishedStep, false, currentBoard, action.second, nextGetThisByPass, nextConsecutivePass, alpha, beta);
+		auto update = [&](const Action action, const Limit& value) {
 			auto comp = best.Evaluation.Compare(value.Evaluation);
 			if (!best.HasValue || comp < 0) {
 				best.Evaluation = value.Evaluation;
 				best.HasValue = true;
-				bestAction = action.first;// <--
+				bestAction = action;// <--
 			}
 			if (!alpha.HasValue || alpha.Evaluation.Compare(best.Evaluation) < 0) {
 				alpha = best;
 			}
+		};
+		auto iter = allActions.begin();
+		for (; iter != allActions.end(); iter++) {
+#ifdef PARALLEL_ALPHA_BETA
+			if (SplitDepth > 0 && iter != allActions.begin()) {
+				break;
+			}
+#endif
+			const auto& action = *iter;
+			const auto nextGetThisByPass = action.first == Action::Pass;
+			const auto nextConsecutivePass = (!isFirstStep && lastBoard == currentBoard) && nextGetThisByPass;
+			auto value = SearchMiniMax(false, depth + 1, me, opponent, nextFinishedStep, false, currentBoard, action.second, nextGetThisByPass, nextConsecutivePass, alpha, beta);
+			update(action.first, value);
+		}
+#ifdef PARALLEL_ALPHA_BETA
+		if (iter != allActions.end()) {
+			tbb::task_group group;
+			tbb::spin_mutex mutex;
+			for (; iter != allActions.end(); iter++) {
+				const auto action = *iter;
+				group.run([&, action]() {
+					Limit a;
+					{
+						tbb::spin_mutex::scoped_lock l(mutex);
+						a = alpha;
+					}
+					const auto nextGetThisByPass = action.first == Action::Pass;
+					const auto nextConsecutivePass = (!isFirstStep && lastBoard == currentBoard) && nextGetThisByPass;
+					auto value = SearchMiniMax(false, depth + 1, me, opponent, nextFinishedStep, false, currentBoard, action.second, nextGetThisByPass, nextConsecutivePass, a, beta);
+					tbb::spin_mutex::scoped_lock l(mutex);
+					update(action.first, value);
+				});
+			}
+			group.wait();
 		}
+#endif
 		assert(best.HasValue);
+		statistics.Local().Seconds = std::chrono::duration<double>(high_resolution_clock::now() - start).count();
 		return std::make_pair(bestAction, best.Evaluation);
 	}
 
+	//all actions at least as good as the k-th best one with their values, best first, ties on the border included
+	//the k-th best value so far bounds later children, only children tied with it are searched again without bound,
+	//unless no value is worse than it, and a k-th best value no value beats bounds nothing
+	vector<pair<Action, E>> SearchBest(const Step finishedStep, const Board lastBoard, const Board currentBoard, const size_t k = 1) {
+		assert(k >= 1);
+		StepInit(finishedStep, currentBoard);
+		statistics.Clear();
+		const auto start = high_resolution_clock::now();
+		statistics.Local().Node(0);
+		auto me = MyPlayer(finishedStep);
+		auto opponent = TurnUtil::Opponent(me);
+		auto isFirstStep = IsFirstStep(me, lastBoard, currentBoard);
+		const auto allActions = AllActions(me, lastBoard, currentBoard, isFirstStep, &actionSequence);
+		const auto nextFinishedStep = finishedStep + 1;
+		vector<pair<Action, E>> result;
+		for (const auto& action : allActions) {
+			const auto nextGetThisByPass = action.first == Action::Pass;
+			const auto nextConsecutivePass = (!isFirstStep && lastBoard == currentBoard) && nextGetThisByPass;
+			const auto kth = result.size() >= k ? Limit(result[k - 1].second) : Limit();
+			const auto bound = kth.HasValue && !Highest(kth.Evaluation) ? kth : Limit();
+			auto value = SearchMiniMax(false, 1, me, opponent, nextFinishedStep, false, currentBoard, action.second, nextGetThisByPass, nextConsecutivePass, bound, Limit());
+			if (!value.HasValue) {//stopped
+				continue;
+			}
+			if (kth.HasValue) {
+				const auto cmp = value.Evaluation.Compare(kth.Evaluation);
+				if (cmp < 0) {
+					continue;
+				}
+				if (cmp == 0 && bound.HasValue && (DepthLimited() || !Lowest(bound.Evaluation))) {//may be an upper bound only
+					value = SearchMiniMax(false, 1, me, opponent, nextFinishedStep, false, currentBoard, action.second, nextGetThisByPass, nextConsecutivePass, Limit(), Limit());
+					if (!value.HasValue || value.Evaluation.Compare(kth.Evaluation) < 0) {
+						continue;
+					}
+				}
+			}
+			auto position = result.begin();
+			while (position != result.end() && position->second.Compare(value.Evaluation) >= 0) {
+				position++;
+			}
+			result.insert(position, std::make_pair(action.first, value.Evaluation));
+			while (result.size() > k && result.back().second.Compare(result[k - 1].second) < 0) {
+				result.pop_back();
+			}
+		}
+		statistics.Local().Seconds = std::chrono::duration<double>(high_resolution_clock::now() - start).count();
+		return result;
+	}
+
 	virtual Action Act(const Step finishedStep, const Board lastBoard, const Board currentBoard) override {
 		auto result = Search(finishedStep, lastBoard, currentBoard);
 		return result.first;
 	}
+
+	//statistics of the last search, merged from all threads
+	SearchStatistics Statistics() const {
+		return statistics.Merged();
+	}
+
+	vector<SearchStatistics> ThreadStatistics() const {
+		return statistics.PerThread();
+	}
+
+	void SetSplitDepth(const Step splitDepth) {
+		SplitDepth = splitDepth;
+	}
+
+	//selective search only works with a depth limit, results are not exact any more
+	void SetLateMoveReduction(const Step index, const Step reduction) {
+		LateMoveIndex = index;
+		LateMoveReduction = reduction;
+	}
+
+	void SetProbCut(const Step reduction, const Step minDepth) {
+		ProbCutReduction = reduction;
+		ProbCutMinDepth = minDepth;
+	}
+
+	void SetProbCut(const ProbCutParameters& parameters) {
+		SetProbCut(parameters.Reduction, parameters.MinDepth);
+	}
+
+	void SetQuiescence(const int nodeBudget) {
+		QuiescenceBudget = nodeBudget;
+	}
+
+	void SetEnhancedTranspositionCutOff(const bool enable) {
+		EnhancedTranspositionCutOff = enable;
+	}
+
+	void SetExtendedKeys(const bool enable) {
+		ExtendedKeys = enable;
+	}
 };
 
 #ifndef SEARCH_MODE
@@ -270,7 +714,27 @@ class StoneCountAlphaBetaAgent : public CachedAlphaBetaAgent<EvaluationTrace<Sto
 private:
 	using E = EvaluationTrace<StoneCountAlphaBetaEvaluation>;
 	array<Step, TOTAL_POSITIONS> depthLimits;//index by num stones
+	std::shared_ptr<const TruthTable> truth;
+	Player me = Player::Black;
 protected:
+	virtual void StepInit(const Step finishedStep, const Board board) override {
+		CachedAlphaBetaAgent<E>::StepInit(finishedStep, board);
+		me = MyPlayer(finishedStep);
+	}
+
+	//solved positions are exact leaves, probed only where the cache is probed (no ko, not after a pass)
+	virtual bool Get(const Step finishedStep, const Board board, E& evaluation) const override {
+		if (CachedAlphaBetaAgent<E>::Get(finishedStep, board, evaluation)) {
+			return true;
+		}
+		WinEval exact;
+		if (truth == nullptr || PositionKey::Extended(board) || !truth->Find(finishedStep, board, exact)) {
+			return false;
+		}
+		const auto win = exact.Win() == (TurnUtil::WhoNext(finishedStep) == me);
+		evaluation = E(StoneCountAlphaBetaEvaluation(win, me, board));
+		return true;
+	}
 public:
 	StoneCountAlphaBetaAgent(const Step _depthLimit, const ActionSequence& _actionSequence = DEFAULT_ACTION_SEQUENCE) : CachedAlphaBetaAgent<EvaluationTrace<StoneCountAlphaBetaEvaluation>>(_actionSequence) {
 		depthLimits.fill(_depthLimit);
@@ -287,6 +751,10 @@ public:
 #endif
 		return CachedAlphaBetaAgent<E>::Act(finishedStep, lastBoard, currentBoard);
 	}
+
+	void SetTruthTable(const std::shared_ptr<const TruthTable>& table) {
+		truth = table;
+	}
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,2 @@
+g++ -std=c++0x -O2 -pthread playout_benchmark.cpp -o playout_benchmark
+./playout_benchmark "$@"
@@ -1,6 +1,11 @@
 //Name: Zongjian Li, USC ID: 6503378943
 #pragma once
 
+#include <functional>
+#include <limits>
+#include <memory>
+#include <set>
+
 #include "go.h"
 #include "eval.h"
 
@@ -205,8 +210,14 @@ public:
 	}
 };
 
+//all winning actions of a position by searching, empty if it loses, never asked for one with a ko action or reached by a pass
+using BestResolver = std::function<vector<Action>(const Step, const Board)>;
+
+//evaluation of a standard board from the view of the player to move, false if not solved
+using ProofLookup = std::function<bool(const Step, const Board, WinEval&)>;
+
 class BestConverter {
-private:
+public:
 	using E = WinEval;
 
 	static string Filename(const string& prefix, const Step finishedStep) {
@@ -224,7 +235,9 @@ private:
 			E record;
 			file.read(reinterpret_cast<char*>(&board), sizeof(board));
 			file.read(reinterpret_cast<char*>(&record), sizeof(record));
-			result[board] = record;
+			if (!PositionKey::Extended(board)) {//ko and opponent passed positions are not needed for best actions
+				result[board] = record;
+			}
 		}
 		file.close();
 		return result;
@@ -233,8 +246,13 @@ private:
 	static map<Board, E> Read(const string& prefix, const Step finishedStep) {
 		return Read(Filename(prefix, finishedStep));
 	}
+private:
+
+	static ActionMask Mask(const Action action) {
+		return action == Action::Pass ? PASS_MASK : static_cast<ActionMask>(action);
+	}
 
-	static map<Board, ActionMask> Calc(const Step finishedStep, const map<Board, E>& source, const map<Board, E>& lookup) {
+	static map<Board, ActionMask> Calc(const Step finishedStep, const map<Board, E>& source, const map<Board, E>& lookup, const BestResolver& resolver) {
 		map<Board, ActionMask> result;
 		auto player = TurnUtil::WhoNext(finishedStep);
 		UINT64 total = 0;
@@ -267,18 +285,21 @@ private:
 				auto cmp = bestE.Compare(e);
 				if (cmp < 0) {
 					bestE = e;
-					bestA = action == Action::Pass ? PASS_MASK : static_cast<ActionMask>(action);
+					bestA = Mask(action);
 				}
 				if (cmp == 0) {
-					if (action == Action::Pass) {//reduce comp complexity
-						bestA |= PASS_MASK;
-					} else {
-						bestA |= static_cast<ActionMask>(action);
-					}
+					bestA |= Mask(action);
 				}
 			}
 			if (!complete) {
 				incomplete++;
+				if (resolver) {//missing children are not treated as losing, search the position instead
+					bestA = EMPTY_BOARD;
+					for (const auto action : resolver(finishedStep, b)) {
+						bestA |= Mask(action);
+					}
+					bestE = E(true, bestA != EMPTY_BOARD);
+				}
 				//continue;
 			}
 			if (!bestE.GoodEnough()) {
@@ -299,15 +320,175 @@ private:
 		cout << "finished step " << int(finishedStep) << " player " << (player == Player::Black ? "X" : "O") << " total/invalid/incomplete/lose/multiple/win: " << total << "/" << invalid << "/" << incomplete << "/" << lose << "/" << multiple << "/" << win << endl;
 		return result;
 	}
+	//solved steps are read from files when first asked, steps before the one asked are dropped
+	static ProofLookup FileLookup(const string& prefix) {
+		auto layers = std::make_shared<map<Step, map<Board, E>>>();
+		return [prefix, layers](const Step finishedStep, const Board board, E& evaluation) {
+			if (layers->find(finishedStep) == layers->end()) {
+				while (!layers->empty() && layers->begin()->first + 1 < finishedStep) {
+					layers->erase(layers->begin());
+				}
+				auto& layer = (*layers)[finishedStep];
+				if (ifstream(Filename(prefix, finishedStep), std::ios::binary).is_open()) {
+					layer = Read(prefix, finishedStep);
+				}
+			}
+			const auto& layer = layers->at(finishedStep);
+			const auto find = layer.find(board);
+			if (find == layer.end()) {
+				return false;
+			}
+			evaluation = find->second;
+			return true;
+		};
+	}
 public:
-	static void Convert(const string& prefix, const int begin, const int end, const int limit) {
+	static void Convert(const string& prefix, const int begin, const int end, const int limit, const BestResolver& resolver = nullptr) {
 		auto next = Read(prefix, begin);
 		for (auto step = begin; step < end; step++) {
 			auto current = std::move(next);
 			next = Read(prefix, step + 1);
 
-			auto result = Calc(step, current, next);
+			auto result = Calc(step, current, next, resolver);
+			Best::Write(step, result, limit);
+		}
+	}
+
+	//only the positions of a winning strategy from the roots are written: one winning action where the player to move wins,
+	//all replies where it loses, the replies need no actions, so each step keeps the winning side only
+	static void ExtractProofTree(const ProofLookup& lookup, const Step begin, const Step end, const vector<Board>& roots, const int limit, const BestResolver& resolver = nullptr) {
+		std::set<Board> frontier;
+		std::set<Board> restricted;//with a ko action or reached by a pass, the resolver searches without a last board so it skips them
+		for (const auto root : roots) {
+			frontier.insert(Isomorphism(root).StandardBoard());
+		}
+		for (auto step = begin; step < end && !frontier.empty(); step++) {
+			const auto player = TurnUtil::WhoNext(step);
+			std::set<Board> next;
+			std::set<Board> nextRestricted;
+			map<Board, ActionMask> result;
+			UINT64 unresolved = 0;
+			UINT64 replied = 0;
+			for (const auto b : frontier) {
+				E e;
+				if (!lookup(step, b, e)) {
+					unresolved++;
+					continue;
+				}
+				const auto actions = LegalActionIterator::ListAll(player, EMPTY_BOARD, b, b == EMPTY_BOARD, &DEFAULT_ACTION_SEQUENCE);
+				if (!e.GoodEnough()) {
+					replied++;
+					for (const auto& a : actions) {
+						const auto child = Isomorphism(a.second).StandardBoard();
+						next.insert(child);
+						bool ko;
+						LegalActionIterator::ListAll(TurnUtil::Opponent(player), b, a.second, false, &DEFAULT_ACTION_SEQUENCE, ko);
+						if (ko || a.first == Action::Pass) {
+							nextRestricted.insert(child);
+						}
+					}
+					continue;
+				}
+				auto bestA = EMPTY_BOARD;
+				auto bestChild = EMPTY_BOARD;
+				auto fewest = std::numeric_limits<size_t>::max();
+				for (const auto& a : actions) {//the winning action leaving the opponent the fewest replies
+					const auto child = Isomorphism(a.second).StandardBoard();
+					E childE;
+					if (!lookup(step + 1, child, childE) || !childE.OpponentView().GoodEnough()) {
+						continue;
+					}
+					const auto replies = LegalActionIterator::ListAll(TurnUtil::Opponent(player), EMPTY_BOARD, child, false, &DEFAULT_ACTION_SEQUENCE).size();
+					if (replies < fewest) {
+						fewest = replies;
+						bestA = Mask(a.first);
+						bestChild = child;
+					}
+				}
+				if (bestA == EMPTY_BOARD && resolver && restricted.find(b) == restricted.end()) {
+					const auto resolved = resolver(step, b);
+					for (const auto& a : actions) {
+						if (!resolved.empty() && a.first == resolved.front()) {
+							bestA = Mask(a.first);
+							bestChild = Isomorphism(a.second).StandardBoard();
+						}
+					}
+				}
+				if (bestA == EMPTY_BOARD) {
+					unresolved++;
+					continue;
+				}
+				result[b] = bestA;
+				next.insert(bestChild);
+			}
+			cout << "finished step " << int(step) << " player " << (player == Player::Black ? "X" : "O") << " tree/unresolved/replied/win: " << frontier.size() << "/" << unresolved << "/" << replied << "/" << result.size() << endl;
 			Best::Write(step, result, limit);
+			frontier = std::move(next);
+			restricted = std::move(nextRestricted);
 		}
 	}
+
+	//proof trees of all positions of the begin step in the solved files
+	static void ConvertProofTree(const string& prefix, const int begin, const int end, const int limit, const BestResolver& resolver = nullptr) {
+		vector<Board> roots;
+		for (const auto& item : Read(prefix, begin)) {
+			roots.push_back(item.first);
+		}
+		ExtractProofTree(FileLookup(prefix), begin, end, roots, limit, resolver);
+	}
+};
+
+//win/loss of solved positions kept in memory, read from the same files BestConverter reads
+//boards are standard boards, evaluations are from the view of the player to move
+class TruthTable {
+private:
+	using E = WinEval;
+
+	array<vector<pair<Board, E>>, MAX_STEP + 1> tables;//index by finished step
+
+	static bool Less(const pair<Board, E>& a, const pair<Board, E>& b) {
+		return a.first < b.first;
+	}
+public:
+	//only the steps from first to last are loaded, a player process probes the few steps its search reaches
+	TruthTable(const string& prefix, const int first = INITIAL_FINISHED_STEP, const int last = MAX_STEP) {
+		for (auto step = std::max(first, static_cast<int>(INITIAL_FINISHED_STEP)); step <= std::min(last, static_cast<int>(MAX_STEP)); step++) {
+			const auto filename = BestConverter::Filename(prefix, static_cast<Step>(step));
+			if (!ifstream(filename, std::ios::binary).is_open()) {//missing steps are just not solved
+				continue;
+			}
+			auto& table = tables[step];
+			for (const auto& item : BestConverter::Read(filename)) {//sorted by board
+				if (item.second.Initialized()) {
+					table.push_back(item);
+				}
+			}
+		}
+	}
+
+	inline bool Covers(const Step finishedStep) const {
+		return finishedStep <= MAX_STEP && !tables[finishedStep].empty();
+	}
+
+	bool Find(const Step finishedStep, const Board board, E& evaluation) const {
+		if (!Covers(finishedStep)) {
+			return false;
+		}
+		const auto& table = tables[finishedStep];
+		const auto key = std::make_pair(Isomorphism(board).StandardBoard(), E());
+		const auto iter = std::lower_bound(table.begin(), table.end(), key, Less);
+		if (iter == table.end() || iter->first != key.first) {
+			return false;
+		}
+		evaluation = iter->second;
+		return true;
+	}
+
+	size_t Size() const {
+		size_t result = 0;
+		for (const auto& t : tables) {
+			result += t.size();
+		}
+		return result;
+	}
 };
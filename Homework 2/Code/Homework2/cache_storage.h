@@ -58,4 +58,8 @@ public:
 	size_t size() const override {
 		return m.size();
 	}
+
+	size_t EntryBytes() const override {//hash map node and list node of the lru
+		return 6 * sizeof(void*) + sizeof(pair<Board, E>);
+	}
 };
\ No newline at end of file
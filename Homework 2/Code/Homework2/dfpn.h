@@ -0,0 +1,261 @@
+//Name: Zongjian Li, USC ID: 6503378943
+#pragma once
+
+#include "go.h"
+#include "eval.h"
+#include "storage_manager.h"
+
+typedef UINT32 ProofNumber;
+
+const static ProofNumber PROOF_INFINITY = 1u << 30;
+
+//table keys reuse the spare high bits of a board: step field, opponent passed flag, valid flag
+const static State PROOF_KEY_PASS = 1ull << EMPTY_SHIFT;
+const static State PROOF_KEY_VALID = 1ull << 63;
+
+class ProofTable {
+public:
+	struct Entry {
+		State Key = 0;
+		Board Last = EMPTY_BOARD;//only used for positions that may have a ko action
+		ProofNumber Proof = 1;
+		ProofNumber Disproof = 1;
+		UINT32 Work = 0;//size of the searched sub tree, smaller ones are replaced first
+	};
+private:
+	const static size_t BUCKET_SIZE = 4;
+
+	vector<Entry> entries;
+	size_t mask;
+
+	inline static size_t Hash(const State key, const Board last) {
+		auto h = key ^ (last * 0x9E3779B97F4A7C15ull);
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdull;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ull;
+		h ^= h >> 33;
+		return static_cast<size_t>(h);
+	}
+
+	inline size_t Bucket(const State key, const Board last) const {
+		return Hash(key, last) & mask & ~(BUCKET_SIZE - 1);
+	}
+public:
+	ProofTable(const size_t capacity) {
+		size_t size = BUCKET_SIZE;
+		while (size < capacity) {
+			size <<= 1;
+		}
+		entries.resize(size);
+		mask = size - 1;
+	}
+
+	bool Get(const State key, const Board last, Entry& entry) const {
+		auto begin = Bucket(key, last);
+		for (auto i = begin; i < begin + BUCKET_SIZE; i++) {
+			if (entries[i].Key == key && entries[i].Last == last) {
+				entry = entries[i];
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void Set(const State key, const Board last, const ProofNumber proof, const ProofNumber disproof, const UINT32 work) {
+		auto begin = Bucket(key, last);
+		auto replace = begin;
+		for (auto i = begin; i < begin + BUCKET_SIZE; i++) {
+			if (entries[i].Key == key && entries[i].Last == last) {
+				replace = i;
+				break;
+			}
+			if (entries[i].Work < entries[replace].Work) {//empty slots have no work
+				replace = i;
+			}
+		}
+		auto& e = entries[replace];
+		e.Key = key;
+		e.Last = last;
+		e.Proof = proof;
+		e.Disproof = disproof;
+		e.Work = work;
+	}
+
+	void Clear() {
+		std::fill(entries.begin(), entries.end(), Entry());
+	}
+
+	size_t Capacity() const {
+		return entries.size();
+	}
+};
+
+//depth-first proof-number search, proof numbers are always from the view of the player to move
+//proved positions are written to the store with the same rules as the alpha-beta searchers, so the best action converter can use them
+class ProofNumberSearcher {
+private:
+	struct Child {
+		Action Act;
+		Board Current;
+		State Key;
+		Board KeyLast;
+		bool GetThisByOpponentPass;
+		bool ConsecutivePass;
+		ProofNumber Proof;
+		ProofNumber Disproof;
+	};
+
+	StorageManager<WinEval>& Store;
+	const ActionSequence& actionSequence;
+	const atomic<bool>& Token;
+	ProofTable table;
+
+	//infinity only comes from a solved child, a large sum stays below it, so it is never taken as solved
+	inline static ProofNumber Add(const ProofNumber a, const ProofNumber b) {
+		if (a == PROOF_INFINITY || b == PROOF_INFINITY) {
+			return PROOF_INFINITY;
+		}
+		return std::min(a + b, PROOF_INFINITY - 1);
+	}
+
+	inline static void Exact(const bool win, ProofNumber& proof, ProofNumber& disproof) {
+		proof = win ? 0 : PROOF_INFINITY;
+		disproof = win ? PROOF_INFINITY : 0;
+	}
+
+	inline static bool MayHaveKoAction(const Board lastBoard, const Board currentBoard) {//ko needs the last action to capture exactly one stone
+		return lastBoard != currentBoard && __builtin_popcountll(Field::OccupyField(lastBoard)) == __builtin_popcountll(Field::OccupyField(currentBoard));
+	}
+
+	inline static pair<State, Board> Key(const Step finishedStep, const Board lastBoard, const Board currentBoard, const bool getThisByOpponentPass) {
+		if (MayHaveKoAction(lastBoard, currentBoard)) {//ko depends on the orientation of both boards
+			return std::make_pair(currentBoard | StepUtil::ConvertStepToStepField(finishedStep) | PROOF_KEY_VALID, lastBoard);
+		}
+		auto standardBoard = Isomorphism(currentBoard).StandardBoard();
+		return std::make_pair(standardBoard | StepUtil::ConvertStepToStepField(finishedStep) | (getThisByOpponentPass ? PROOF_KEY_PASS : 0) | PROOF_KEY_VALID, EMPTY_BOARD);
+	}
+
+	inline static bool Finished(const Board currentBoard, const Player player) {
+		return WinEval(player, currentBoard).Win();
+	}
+
+	Child Expand(const Step finishedStep, const Board currentBoard, const bool getThisByOpponentPass, const std::pair<Action, Board>& action) {
+		Child child;
+		child.Act = action.first;
+		child.Current = action.second;
+		child.GetThisByOpponentPass = action.first == Action::Pass;
+		child.ConsecutivePass = getThisByOpponentPass && child.GetThisByOpponentPass;
+		const Step nextFinishedStep = finishedStep + 1;
+		if (child.ConsecutivePass || nextFinishedStep == MAX_STEP) {
+			Exact(Finished(child.Current, TurnUtil::WhoNext(nextFinishedStep)), child.Proof, child.Disproof);
+			return child;
+		}
+		auto key = Key(nextFinishedStep, currentBoard, child.Current, child.GetThisByOpponentPass);
+		child.Key = key.first;
+		child.KeyLast = key.second;
+		ProofTable::Entry entry;
+		WinEval fetch;
+		if (table.Get(child.Key, child.KeyLast, entry)) {
+			child.Proof = entry.Proof;
+			child.Disproof = entry.Disproof;
+		} else if (!child.GetThisByOpponentPass && child.KeyLast == EMPTY_BOARD && Store.Get(nextFinishedStep, child.Current, fetch)) {//no ko action for sure
+			Exact(fetch.Win(), child.Proof, child.Disproof);
+		} else {
+			child.Proof = 1;
+			child.Disproof = 1;
+		}
+		return child;
+	}
+
+	UINT32 MID(const Step finishedStep, const Board lastBoard, const Board currentBoard, const bool getThisByOpponentPass, const pair<State, Board>& key, const ProofNumber proofThreshold, const ProofNumber disproofThreshold, ProofNumber& proof, ProofNumber& disproof, Action& bestAction) {
+		Nodes++;
+		bestAction = Action::Pass;
+		const auto player = TurnUtil::WhoNext(finishedStep);
+		bool hasKoAction;
+		const auto actions = LegalActionIterator::ListAll(player, lastBoard, currentBoard, finishedStep == INITIAL_FINISHED_STEP, &actionSequence, hasKoAction);
+		WinEval fetch;
+		if (!hasKoAction && !getThisByOpponentPass && Store.Get(finishedStep, currentBoard, fetch)) {
+			Exact(fetch.Win(), proof, disproof);
+			table.Set(key.first, key.second, proof, disproof, 1);
+			return 1;
+		}
+		vector<Child> children;
+		children.reserve(actions.size());
+		for (const auto& action : actions) {
+			children.push_back(Expand(finishedStep, currentBoard, getThisByOpponentPass, action));
+		}
+		UINT32 work = 1;
+		while (!Token) {
+			proof = PROOF_INFINITY;
+			disproof = 0;
+			Child* best = nullptr;
+			ProofNumber second = PROOF_INFINITY;
+			for (auto& child : children) {
+				disproof = Add(disproof, child.Proof);
+				if (best == nullptr || child.Disproof < best->Disproof) {
+					if (best != nullptr) {
+						second = best->Disproof;
+					}
+					best = &child;
+				} else if (child.Disproof < second) {
+					second = child.Disproof;
+				}
+			}
+			proof = best->Disproof;
+			if (proof >= proofThreshold || disproof >= disproofThreshold) {
+				break;
+			}
+			const auto childProofThreshold = disproofThreshold - disproof + best->Proof;
+			const auto childDisproofThreshold = std::min(proofThreshold, second + 1);
+			Action childBestAction;
+			work += MID(finishedStep + 1, currentBoard, best->Current, best->GetThisByOpponentPass, std::make_pair(best->Key, best->KeyLast), childProofThreshold, childDisproofThreshold, best->Proof, best->Disproof, childBestAction);
+		}
+		if (Token) {
+			return work;
+		}
+		table.Set(key.first, key.second, proof, disproof, work);
+		if (proof == 0 || disproof == 0) {
+			const auto win = proof == 0;
+			auto byConsecutivePass = true;
+			for (const auto& child : children) {
+				if (child.Disproof == 0 && (byConsecutivePass || !child.ConsecutivePass)) {
+					bestAction = child.Act;
+					byConsecutivePass = child.ConsecutivePass;
+				}
+			}
+			if (!hasKoAction && (!getThisByOpponentPass || (win && !byConsecutivePass))) {//same as the alpha-beta searchers, never store success by 2 passings
+				Store.Set(finishedStep, currentBoard, WinEval(true, win));
+			}
+		}
+		return work;
+	}
+
+public:
+	UINT64 Nodes = 0;
+
+	ProofNumberSearcher(StorageManager<WinEval>& _store, const ActionSequence& _actionSequence, const size_t _capacity, const atomic<bool>& _token) : Store(_store), actionSequence(_actionSequence), Token(_token), table(_capacity) {}
+
+	//evaluation is not initialized if stopped by token or the root is not solved
+	pair<Action, WinEval> Solve(const Step finishedStep, const Board lastBoard, const Board currentBoard) {
+		const auto player = TurnUtil::WhoNext(finishedStep);
+		if (finishedStep == MAX_STEP) {
+			return std::make_pair(Action::Pass, WinEval(player, currentBoard));
+		}
+		const auto getThisByOpponentPass = finishedStep != INITIAL_FINISHED_STEP && lastBoard == currentBoard;
+		ProofNumber proof, disproof;
+		Action bestAction;
+		MID(finishedStep, lastBoard, currentBoard, getThisByOpponentPass, Key(finishedStep, lastBoard, currentBoard, getThisByOpponentPass), PROOF_INFINITY, PROOF_INFINITY, proof, disproof, bestAction);
+		if (Token) {
+			return std::make_pair(Action::Pass, WinEval());
+		}
+		if (proof != 0 && disproof != 0) {
+			return std::make_pair(Action::Pass, WinEval());
+		}
+		return std::make_pair(bestAction, WinEval(true, proof == 0));
+	}
+
+	void ClearTable() {
+		table.Clear();
+	}
+};
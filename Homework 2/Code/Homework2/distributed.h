@@ -0,0 +1,418 @@
+//Name: Zongjian Li, USC ID: 6503378943
+#pragma once
+
+#include <condition_variable>
+
+#include "cache_storage.h"
+#include "storage_manager.h"
+
+//several search processes solve one game together, every standard key is owned by one process chosen by the hash of its board,
+//a process keeps only its own positions in the step stores, results of other positions are sent to their owners
+
+enum class MessageType : unsigned char {
+	Store,//a result for the owner
+	Query,//the owner is asked for a result
+	Reply,
+	Done,//all sub trees of the sender are solved
+};
+
+template <typename E>
+class Message {
+public:
+	MessageType Type = MessageType::Store;
+	Step FinishedStep = 0;
+	unsigned short From = 0;
+	bool Found = false;
+	UINT32 Id = 0;//of a query, copied to its reply
+	Board Key = 0;
+	E Evaluation;
+};
+
+template <typename E>
+class MessageChannel {
+public:
+	virtual ~MessageChannel() = default;
+	virtual void Send(const int to, const Message<E>& message) = 0;//buffered until flushed
+	virtual void Flush() = 0;
+	virtual void Receive(vector<Message<E>>& messages) = 0;//appends arrived messages, does not wait
+	virtual void Reset() = 0;//messages sent so far and not received yet are dropped
+};
+
+//one file for each ordered pair of processes, appended by the sender only, so processes on one machine or a shared file system can talk
+//a file starts with the run id of its sender, a receiver seeing another id starts over at the first message, so a restarted or reset sender is not skipped
+//a file left by a crashed run is still read by a receiver started before its sender restarts
+template <typename E>
+class FileChannel : public MessageChannel<E> {
+private:
+	class Outbox {
+	public:
+		std::mutex Mutex;
+		vector<Message<E>> Messages;
+		string Filename;
+		ofstream File;
+	};
+
+	class Inbox {
+	public:
+		string Filename;
+		ifstream File;
+		UINT64 Run = 0;
+		std::streamoff Offset = 0;
+	};
+
+	vector<std::unique_ptr<Outbox>> outboxes;
+	vector<std::unique_ptr<Inbox>> inboxes;
+	std::mutex receiving;
+	UINT64 run = 0;
+
+	static string Filename(const string& prefix, const int from, const int to) {
+		return prefix + "msg_" + std::to_string(from) + "_" + std::to_string(to);
+	}
+
+	static UINT64 NewRun() {
+		std::random_device device;
+		const auto run = (static_cast<UINT64>(device()) << 32) ^ device() ^ static_cast<UINT64>(high_resolution_clock::now().time_since_epoch().count());
+		return run == 0 ? 1 : run;//0 is never seen by an inbox
+	}
+
+	//with the outbox locked
+	void Open(Outbox& outbox) {
+		outbox.File.close();
+		outbox.File.open(outbox.Filename, std::ios::binary | std::ios::trunc);
+		assert(outbox.File.is_open());
+		outbox.File.write(reinterpret_cast<const char*>(&run), sizeof(run));
+		outbox.File.flush();
+	}
+public:
+	//files left by an earlier run of this process are truncated
+	FileChannel(const string& prefix, const int rank, const int num) : run(NewRun()) {
+		for (auto i = 0; i < num; i++) {
+			outboxes.push_back(std::unique_ptr<Outbox>(new Outbox()));
+			inboxes.push_back(std::unique_ptr<Inbox>(new Inbox()));
+			if (i != rank) {
+				outboxes[i]->Filename = Filename(prefix, rank, i);
+				Open(*outboxes[i]);
+				inboxes[i]->Filename = Filename(prefix, i, rank);
+			}
+		}
+	}
+
+	virtual void Send(const int to, const Message<E>& message) override {
+		auto& outbox = *outboxes[to];
+		std::lock_guard<std::mutex> l(outbox.Mutex);
+		outbox.Messages.push_back(message);
+	}
+
+	virtual void Flush() override {
+		for (auto& outbox : outboxes) {
+			std::lock_guard<std::mutex> l(outbox->Mutex);
+			if (outbox->Messages.empty()) {
+				continue;
+			}
+			outbox->File.write(reinterpret_cast<const char*>(outbox->Messages.data()), outbox->Messages.size() * sizeof(Message<E>));
+			outbox->File.flush();
+			outbox->Messages.clear();
+		}
+	}
+
+	//a message partly written by the sender is read again next time
+	virtual void Receive(vector<Message<E>>& messages) override {
+		std::lock_guard<std::mutex> l(receiving);
+		for (auto& inbox : inboxes) {
+			if (inbox->Filename.empty()) {
+				continue;
+			}
+			if (!inbox->File.is_open()) {
+				inbox->File.open(inbox->Filename, std::ios::binary);
+				if (!inbox->File.is_open()) {//the sender has not started yet
+					continue;
+				}
+			}
+			inbox->File.clear();
+			inbox->File.seekg(0);
+			UINT64 run;
+			if (!inbox->File.read(reinterpret_cast<char*>(&run), sizeof(run))) {//truncated by a restarting sender, the id is not written yet
+				continue;
+			}
+			if (run != inbox->Run) {
+				inbox->Run = run;
+				inbox->Offset = sizeof(run);
+			}
+			inbox->File.seekg(inbox->Offset);
+			Message<E> message;
+			while (inbox->File.read(reinterpret_cast<char*>(&message), sizeof(message))) {
+				messages.push_back(message);
+				inbox->Offset += sizeof(message);
+			}
+		}
+	}
+
+	//the files start over with a new run id
+	virtual void Reset() override {
+		run = NewRun();
+		for (auto& outbox : outboxes) {
+			std::lock_guard<std::mutex> l(outbox->Mutex);
+			outbox->Messages.clear();
+			if (!outbox->Filename.empty()) {
+				Open(*outbox);
+			}
+		}
+	}
+};
+
+const static int QUERY_TIMEOUT_MILLISECONDS = 2000;
+const static int PUMP_INTERVAL_MILLISECONDS = 2;
+
+template <typename E>
+class DistributedStore : public RemoteRecords<E> {
+private:
+	StorageManager<E>& local;
+	const int rank;
+	const int num;
+	std::unique_ptr<MessageChannel<E>> channel;
+	array<std::unique_ptr<CacheRecordStorage<E>>, MAX_STEP + 1> caches;//results of other processes seen by this process
+	std::mutex answerMutex;
+	std::condition_variable answered;
+	map<UINT32, pair<bool, E>> answers;
+	set<UINT32> pending;//queries still waited for, a reply to any other one came after its timeout and is dropped
+	atomic<UINT32> nextId;
+	vector<bool> done;
+	int doneCount = 0;
+	bool doneSent = false;
+	std::unique_ptr<thread> pump;
+	atomic<bool> stop;
+	atomic<UINT64> sent;
+	atomic<UINT64> received;
+	atomic<UINT64> queries;
+	atomic<UINT64> remoteHits;
+	atomic<UINT64> timeouts;
+	atomic<UINT64> lateReplies;
+
+	void Send(const int to, Message<E> message) {
+		message.From = static_cast<unsigned short>(rank);
+		channel->Send(to, message);
+		sent++;
+	}
+
+	void Handle(const Message<E>& message) {
+		switch (message.Type) {
+		case MessageType::Store:
+			local.Set(message.FinishedStep, message.Key, message.Evaluation);
+			break;
+		case MessageType::Query: {
+			auto reply = message;
+			reply.Type = MessageType::Reply;
+			reply.Found = local.Get(message.FinishedStep, message.Key, reply.Evaluation);
+			Send(message.From, reply);
+			break;
+		}
+		case MessageType::Reply: {
+			std::lock_guard<std::mutex> l(answerMutex);
+			if (pending.erase(message.Id) == 0) {
+				lateReplies++;
+				break;
+			}
+			answers[message.Id] = std::make_pair(message.Found, message.Evaluation);
+			answered.notify_all();
+			break;
+		}
+		case MessageType::Done: {
+			std::lock_guard<std::mutex> l(answerMutex);
+			if (!done[message.From]) {
+				done[message.From] = true;
+				doneCount++;
+				cout << "Sub trees of process " << message.From << " are solved" << endl;
+			}
+			break;
+		}
+		}
+	}
+
+	void Pump() {
+		vector<Message<E>> messages;
+		while (!stop) {
+			channel->Flush();
+			messages.clear();
+			channel->Receive(messages);
+			received += messages.size();
+			for (const auto& message : messages) {
+				Handle(message);
+			}
+			if (messages.empty()) {
+				std::this_thread::sleep_for(milliseconds(PUMP_INTERVAL_MILLISECONDS));
+			}
+		}
+		channel->Flush();
+	}
+public:
+	Step QueryStep = 0;//other processes are asked for positions up to this step, deeper ones are searched again when not cached, waiting would cost more
+
+	//the cache holds given records per step, message files are named by the prefix
+	DistributedStore(StorageManager<E>& _local, const string& prefix, const int _rank, const int _num, const size_t cacheCapacity) : local(_local), rank(_rank), num(_num), channel(new FileChannel<E>(prefix, _rank, _num)), nextId(0), done(_num, false), stop(false), sent(0), received(0), queries(0), remoteHits(0), timeouts(0), lateReplies(0) {
+		assert(0 <= rank && rank < num);
+		for (auto& cache : caches) {
+			cache = std::unique_ptr<CacheRecordStorage<E>>(new CacheRecordStorage<E>(cacheCapacity, thread::hardware_concurrency() * 2));
+		}
+		local.Distribute(this, PartitionName(rank));
+		pump = std::unique_ptr<thread>(new thread(&DistributedStore::Pump, this));
+	}
+
+	~DistributedStore() {
+		stop = true;
+		pump->join();
+		local.Distribute(nullptr, "");
+	}
+
+	static string PartitionName(const int rank) {
+		return "part" + std::to_string(rank) + "_";
+	}
+
+	inline static int Owner(const Board standardKey, const int num) {//the board only, so plain and extended keys of a position agree
+		return static_cast<int>(((Field::BoardField(standardKey) * 0x9E3779B97F4A7C15ull) >> 32) % static_cast<UINT64>(num));
+	}
+
+	virtual bool Owned(const Board standardKey) const override {
+		return Owner(standardKey, num) == rank;
+	}
+
+	virtual bool Get(const Step finishedStep, const Board standardKey, E& record) override {
+		if (caches[finishedStep]->Get(standardKey, record)) {
+			return true;
+		}
+		if (finishedStep > QueryStep) {
+			return false;
+		}
+		Message<E> query;
+		query.Type = MessageType::Query;
+		query.FinishedStep = finishedStep;
+		query.Id = nextId++;
+		query.Key = standardKey;
+		std::unique_lock<std::mutex> l(answerMutex);
+		pending.insert(query.Id);//before sending, the reply may come at once
+		l.unlock();
+		Send(Owner(standardKey, num), query);
+		channel->Flush();
+		queries++;
+		l.lock();
+		if (!answered.wait_for(l, milliseconds(QUERY_TIMEOUT_MILLISECONDS), [&]() { return answers.find(query.Id) != answers.end(); })) {
+			pending.erase(query.Id);
+			timeouts++;
+			return false;
+		}
+		const auto answer = answers[query.Id];
+		answers.erase(query.Id);
+		l.unlock();
+		if (!answer.first) {
+			return false;
+		}
+		record = answer.second;
+		caches[finishedStep]->Set(standardKey, record);
+		remoteHits++;
+		return true;
+	}
+
+	virtual void Set(const Step finishedStep, const Board standardKey, const E& record) override {
+		caches[finishedStep]->Set(standardKey, record);
+		Message<E> store;
+		store.Type = MessageType::Store;
+		store.FinishedStep = finishedStep;
+		store.Key = standardKey;
+		store.Evaluation = record;
+		Send(Owner(standardKey, num), store);
+	}
+
+	//called when all sub trees of this process are solved, tells the others once, only process 0 searches the root after all are done
+	bool RootGate() {
+		std::lock_guard<std::mutex> l(answerMutex);
+		if (!doneSent) {
+			doneSent = true;
+			if (!done[rank]) {
+				done[rank] = true;
+				doneCount++;
+			}
+			Message<E> message;
+			message.Type = MessageType::Done;
+			for (auto i = 0; i < num; i++) {
+				if (i != rank) {
+					Send(i, message);
+				}
+			}
+			cout << "Sub trees of this process are solved" << endl;
+		}
+		return rank == 0 && doneCount == num;
+	}
+
+	//for a new split, all processes must be reset before any of them starts again
+	void Reset() {
+		channel->Reset();
+		std::lock_guard<std::mutex> l(answerMutex);
+		std::fill(done.begin(), done.end(), false);
+		doneCount = 0;
+		doneSent = false;
+	}
+
+	void Report() const {
+		cout << "Current distributed process: " << rank << " of " << num << ", query step " << int(QueryStep) << endl;
+		cout << "\t" << "sent " << sent << ", received " << received << ", queries " << queries << ", remote hits " << remoteHits << ", timeouts " << timeouts << ", late replies " << lateReplies << endl;
+	}
+
+	//partition files written by serializing each process are merged by key into the usual step files
+	static void Merge(const string& prefix, const int num) {
+		for (auto step = 0; step <= MAX_STEP; step++) {
+			vector<std::unique_ptr<ifstream>> files;
+			vector<UINT64> left;
+			for (auto i = 0; i < num; i++) {
+				auto file = std::unique_ptr<ifstream>(new ifstream(prefix + PartitionName(i) + std::to_string(step), std::ios::binary));
+				if (!file->is_open()) {
+					continue;
+				}
+				UINT64 size;
+				file->read(reinterpret_cast<char*>(&size), sizeof(size));
+				files.push_back(std::move(file));
+				left.push_back(size);
+			}
+			if (files.empty()) {
+				continue;
+			}
+			typedef tuple<Board, size_t, E> Head;
+			auto greater = [](const Head& a, const Head& b) { return std::get<0>(a) > std::get<0>(b); };
+			std::priority_queue<Head, vector<Head>, decltype(greater)> heads(greater);
+			auto next = [&](const size_t i) {
+				if (left[i] == 0) {
+					return;
+				}
+				left[i]--;
+				Board key;
+				E evaluation;
+				files[i]->read(reinterpret_cast<char*>(&key), sizeof(key));
+				files[i]->read(reinterpret_cast<char*>(&evaluation), sizeof(evaluation));
+				heads.emplace(key, i, evaluation);
+			};
+			for (size_t i = 0; i < files.size(); i++) {
+				next(i);
+			}
+			const auto filename = prefix + std::to_string(step);
+			ofstream file(filename, std::ios::binary);
+			assert(file.is_open());
+			UINT64 size = 0;
+			file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+			auto last = Board(0);
+			while (!heads.empty()) {
+				const auto head = heads.top();
+				heads.pop();
+				next(std::get<1>(head));
+				if (size > 0 && std::get<0>(head) == last) {
+					continue;
+				}
+				last = std::get<0>(head);
+				file.write(reinterpret_cast<const char*>(&last), sizeof(last));
+				file.write(reinterpret_cast<const char*>(&std::get<2>(head)), sizeof(E));
+				size++;
+			}
+			file.seekp(0);
+			file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+			file.close();
+			cout << "Merged " << files.size() << " partitions into " << filename << " with " << size << " entries" << endl;
+		}
+	}
+};
@@ -0,0 +1,185 @@
+//Name: Zongjian Li, USC ID: 6503378943
+#pragma once
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "go.h"
+
+const static string ENDGAME_FILENAME = "endgame" + HELPER_FILE_EXTENSION;
+
+//an entry is a standard PositionKey key, the best action of its board as point index + 1 (0 for passing) and the win flag of the player to move
+const static UINT64 ENDGAME_KEY_MASK = (KEY_PASS << 1) - 1;
+const static int ENDGAME_ACTION_SHIFT = EMPTY_SHIFT + 1;
+const static UINT64 ENDGAME_WIN = 1ull << 63;
+const static int ENDGAME_HEADER_SIZE = MAX_STEP + 2;//entry offsets of each finished step and the end
+
+class EndgameEntry {
+public:
+	inline static UINT64 Make(const Board key, const bool win, const Action action) {
+		const auto index = action == Action::Pass ? 0ull : static_cast<UINT64>(__builtin_ctzll(static_cast<UINT64>(action)) + 1);
+		return key | (index << ENDGAME_ACTION_SHIFT) | (win ? ENDGAME_WIN : 0);
+	}
+
+	inline static Board Key(const UINT64 entry) {
+		return entry & ENDGAME_KEY_MASK;
+	}
+
+	inline static bool Win(const UINT64 entry) {
+		return (entry & ENDGAME_WIN) != 0;
+	}
+
+	inline static Action BestAction(const UINT64 entry) {
+		const auto index = (entry >> ENDGAME_ACTION_SHIFT) & 0x1F;
+		return index == 0 ? Action::Pass : static_cast<Action>(1ull << (index - 1));
+	}
+};
+
+//solved late positions in one file written by EndgameBuilder: the header, then entries sorted by key within each step
+//the file is mapped instead of read, so a lookup only touches the pages of its binary search
+class EndgameTable {
+private:
+	const UINT64* data = nullptr;
+	size_t bytes = 0;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#else
+	int file = -1;
+#endif
+
+	void Map(const string& filename) {
+#ifdef _WIN32
+		file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return;
+		}
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+			return;
+		}
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr) {
+			return;
+		}
+		data = static_cast<const UINT64*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		bytes = data == nullptr ? 0 : static_cast<size_t>(size.QuadPart);
+#else
+		file = open(filename.c_str(), O_RDONLY);
+		if (file < 0) {
+			return;
+		}
+		struct stat status;
+		if (fstat(file, &status) != 0 || status.st_size == 0) {
+			return;
+		}
+		auto result = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, file, 0);
+		if (result == MAP_FAILED) {
+			return;
+		}
+		data = static_cast<const UINT64*>(result);
+		bytes = static_cast<size_t>(status.st_size);
+#endif
+	}
+
+	void Unmap() {
+#ifdef _WIN32
+		if (data != nullptr) {
+			UnmapViewOfFile(data);
+		}
+		if (mapping != nullptr) {
+			CloseHandle(mapping);
+		}
+		if (file != INVALID_HANDLE_VALUE) {
+			CloseHandle(file);
+		}
+		mapping = nullptr;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (data != nullptr) {
+			munmap(const_cast<UINT64*>(data), bytes);
+		}
+		if (file >= 0) {
+			close(file);
+		}
+		file = -1;
+#endif
+		data = nullptr;
+		bytes = 0;
+	}
+
+	inline const UINT64* Entries() const {
+		return data + ENDGAME_HEADER_SIZE;
+	}
+public:
+	//a missing or broken file is an empty table
+	EndgameTable(const string& filename = ENDGAME_FILENAME) {
+		Map(filename);
+		if (data != nullptr && (bytes < ENDGAME_HEADER_SIZE * sizeof(UINT64) || bytes != (ENDGAME_HEADER_SIZE + data[MAX_STEP + 1]) * sizeof(UINT64))) {
+			Unmap();
+		}
+	}
+
+	~EndgameTable() {
+		Unmap();
+	}
+
+	EndgameTable(const EndgameTable&) = delete;
+	EndgameTable& operator = (const EndgameTable&) = delete;
+
+	inline bool Loaded() const {
+		return data != nullptr;
+	}
+
+	inline UINT64 Size() const {
+		return Loaded() ? data[MAX_STEP + 1] : 0;
+	}
+
+	inline bool Covers(const Step finishedStep) const {
+		return Loaded() && finishedStep <= MAX_STEP && data[finishedStep] < data[finishedStep + 1];
+	}
+
+	//the entry of a standard key
+	bool FindEntry(const Step finishedStep, const Board key, UINT64& entry) const {
+		if (!Covers(finishedStep)) {
+			return false;
+		}
+		auto begin = Entries() + data[finishedStep];
+		auto end = Entries() + data[finishedStep + 1];
+		auto iter = std::lower_bound(begin, end, key, [](const UINT64 e, const Board k) {
+			return EndgameEntry::Key(e) < k;
+		});
+		if (iter == end || EndgameEntry::Key(*iter) != key) {
+			return false;
+		}
+		entry = *iter;
+		return true;
+	}
+
+	//win or loss of the player to move, and the best action on the given board, which is only meaningful for a win
+	bool Find(const Step finishedStep, const Board lastBoard, const Board currentBoard, bool& win, Action& action) const {
+		if (!Covers(finishedStep)) {
+			return false;
+		}
+		const auto isFirstStep = finishedStep == INITIAL_FINISHED_STEP;
+		bool ko;
+		Action koAction;
+		LegalActionIterator::ListAll(TurnUtil::WhoNext(finishedStep), lastBoard, currentBoard, isFirstStep, &DEFAULT_ACTION_SEQUENCE, ko, koAction);
+		UINT64 entry;
+		if (!FindEntry(finishedStep, PositionKey::Standard(PositionKey::Make(currentBoard, koAction, !isFirstStep && lastBoard == currentBoard)), entry)) {
+			return false;
+		}
+		win = EndgameEntry::Win(entry);
+		action = Isomorphism(currentBoard).ReverseActionWithKo(koAction, EndgameEntry::BestAction(entry));
+		return true;
+	}
+};
@@ -0,0 +1,159 @@
+//Name: Zongjian Li, USC ID: 6503378943
+#pragma once
+
+#include "retrograde.h"
+#include "endgame.h"
+
+//the endgame table of all positions reachable from many roots at one finished step, enumerated and solved layer by layer in memory as RetrogradeSolver does
+//a position reached from several roots is solved once, roots from random games cover the late positions of games like them
+class EndgameBuilder {
+public:
+	using E = WinEval;
+private:
+	const int threadNum;
+	array<vector<UINT64>, MAX_STEP + 1> entries;//index by finished step, sorted by key
+
+	static bool Less(const UINT64 entry, const Board key) {
+		return EndgameEntry::Key(entry) < key;
+	}
+
+	static bool Find(const vector<UINT64>& layer, const Board key, UINT64& entry) {
+		const auto iter = std::lower_bound(layer.begin(), layer.end(), key, Less);
+		if (iter == layer.end() || EndgameEntry::Key(*iter) != key) {
+			return false;
+		}
+		entry = *iter;
+		return true;
+	}
+
+	const static UINT64 KEPT_FLAG = 1ull << 62;//marks the kept entries while solving, a key may be 0
+
+	inline static int EmptyCount(const Board key) {
+		return TOTAL_POSITIONS - static_cast<int>(__builtin_popcountll(Field::BoardField(key) >> OCCUPY_SHIFT));
+	}
+public:
+	EndgameBuilder(const int _threadNum) : threadNum(_threadNum) {}
+
+	//last and current boards of games played randomly until the finished step, games finished by 2 passings are skipped
+	static vector<pair<Board, Board>> RandomRoots(const Step finishedStep, const int count, const unsigned int seed) {
+		std::mt19937 rng(seed);
+		vector<pair<Board, Board>> roots;
+		while (roots.size() < static_cast<size_t>(count)) {
+			Board last = EMPTY_BOARD, current = EMPTY_BOARD;
+			auto passes = 0;
+			for (Step step = 0; step < finishedStep && passes < 2; step++) {
+				const auto actions = LegalActionIterator::ListAll(TurnUtil::WhoNext(step), last, current, step == INITIAL_FINISHED_STEP, &DEFAULT_ACTION_SEQUENCE);
+				const auto& a = actions[rng() % actions.size()];
+				passes = a.first == Action::Pass ? passes + 1 : 0;
+				last = current;
+				current = a.second;
+			}
+			if (passes < 2) {
+				roots.emplace_back(last, current);
+			}
+		}
+		return roots;
+	}
+
+	//enumerate forward from the roots, then solve backward, the best action of a position is its first winning one
+	//a position with a missing child is only kept if another child wins, so every entry is exact
+	void Build(const Step rootFinishedStep, const vector<pair<Board, Board>>& roots) {
+		assert(rootFinishedStep < MAX_STEP);
+		for (auto& layer : entries) {
+			vector<UINT64>().swap(layer);
+		}
+		RetrogradeSolver solver("", threadNum);
+		array<RetrogradeSolver::Layer, MAX_STEP + 1> layers;
+		for (const auto& root : roots) {
+			layers[rootFinishedStep].emplace_back(RetrogradeSolver::RootKey(rootFinishedStep, root.first, root.second), E());
+		}
+		auto& rootLayer = layers[rootFinishedStep];
+		std::sort(rootLayer.begin(), rootLayer.end(), [](const pair<Board, E>& a, const pair<Board, E>& b) { return a.first < b.first; });
+		rootLayer.erase(std::unique(rootLayer.begin(), rootLayer.end(), [](const pair<Board, E>& a, const pair<Board, E>& b) { return a.first == b.first; }), rootLayer.end());
+		auto lastStep = rootFinishedStep;
+		for (; lastStep + 1 < MAX_STEP; lastStep++) {
+			cout << "Enumerated step " << int(lastStep) << ": " << layers[lastStep].size() << " positions" << endl;
+			layers[lastStep + 1] = solver.Expand(lastStep, layers[lastStep]);
+			if (layers[lastStep + 1].empty()) {
+				break;
+			}
+		}
+		for (auto step = lastStep; ; step--) {
+			const auto& layer = layers[step];
+			const auto& next = entries[step + 1];
+			auto& solved = entries[step];
+			solved.resize(layer.size());
+			atomic<UINT64> missing(0);
+			RetrogradeSolver::Parallel(threadNum, layer.size(), [&](const size_t begin, const size_t end, const size_t) {
+				for (auto i = begin; i < end; i++) {
+					auto win = false;
+					auto incomplete = false;
+					auto best = Action::Pass;
+					auto first = true;
+					RetrogradeSolver::ForEachMove(step, layer[i].first, [&](const Action action, const Board key, const bool terminal, const E& evaluation) {
+						if (win) {
+							return;
+						}
+						if (first) {//kept for a loss, so the action is at least legal
+							best = action;
+							first = false;
+						}
+						auto value = evaluation.Win();
+						if (!terminal) {
+							UINT64 child;
+							if (!Find(next, key, child)) {
+								missing++;
+								incomplete = true;
+								return;
+							}
+							value = !EndgameEntry::Win(child);
+						}
+						if (value) {
+							win = true;
+							best = action;
+						}
+					});
+					solved[i] = incomplete && !win ? 0 : EndgameEntry::Make(layer[i].first, win, best) | KEPT_FLAG;
+				}
+			});
+			solved.erase(std::remove(solved.begin(), solved.end(), 0ull), solved.end());
+			for (auto& entry : solved) {
+				entry &= ~KEPT_FLAG;
+			}
+			cout << "Solved step " << int(step) << ": " << solved.size() << " positions" << (missing > 0 ? ", missing children " + std::to_string(missing.load()) + ", left out " + std::to_string(layer.size() - solved.size()) : "") << endl;
+			RetrogradeSolver::Layer().swap(layers[step]);
+			if (step == rootFinishedStep) {
+				break;
+			}
+		}
+	}
+
+	//positions with more empty points are left out, TOTAL_POSITIONS to keep all
+	void Write(const string& filename, const int maxEmptyCount) const {
+		array<UINT64, ENDGAME_HEADER_SIZE> offsets;
+		vector<UINT64> kept;
+		for (Step step = 0; step <= MAX_STEP; step++) {
+			offsets[step] = kept.size();
+			for (const auto entry : entries[step]) {
+				if (EmptyCount(EndgameEntry::Key(entry)) <= maxEmptyCount) {
+					kept.push_back(entry);
+				}
+			}
+		}
+		offsets[MAX_STEP + 1] = kept.size();
+		ofstream file(filename, std::ios::binary);
+		assert(file.is_open());
+		file.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(UINT64));
+		file.write(reinterpret_cast<const char*>(kept.data()), kept.size() * sizeof(UINT64));
+		file.close();
+		cout << "Endgame table: " << kept.size() << " positions, " << (offsets.size() + kept.size()) * sizeof(UINT64) << " bytes" << endl;
+	}
+
+	UINT64 Size() const {
+		UINT64 result = 0;
+		for (const auto& layer : entries) {
+			result += layer.size();
+		}
+		return result;
+	}
+};
@@ -0,0 +1,157 @@
+//Name: Zongjian Li, USC ID: 6503378943
+#pragma once
+
+#include <limits>
+
+#include <stxxl/bits/containers/sorter.h>
+
+#include "retrograde.h"
+
+const static size_t ENUMERATION_CHUNK_SIZE = 1 << 20;//positions read from a layer file at once
+
+//forward enumeration of the standard position keys reachable at each finished step
+//children of a layer are pushed to an external sorter, so a layer never has to fit in memory,
+//the sorted output is written to the same layer files as RetrogradeSolver, which can solve them afterwards
+class LayerEnumerator {
+public:
+	using E = RetrogradeSolver::E;
+private:
+	struct KeyLess {
+		bool operator()(const Board a, const Board b) const {
+			return a < b;
+		}
+
+		Board min_value() const {
+			return std::numeric_limits<Board>::min();
+		}
+
+		Board max_value() const {//never a key, extra fields stop below bit 56
+			return std::numeric_limits<Board>::max();
+		}
+	};
+
+	using Sorter = stxxl::sorter<Board, KeyLess>;
+
+	const string prefix;
+	const size_t memory;
+	const int threadNum;
+
+	//keys are given in increasing order, duplicates are skipped, the size is written in the head at the end
+	class LayerWriter {
+	private:
+		ofstream file;
+		UINT64 size = 0;
+		Board last = 0;
+	public:
+		LayerWriter(const string& filename) : file(filename, std::ios::binary) {
+			assert(file.is_open());
+			file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+		}
+
+		void Push(const Board key) {
+			if (size > 0 && key == last) {
+				return;
+			}
+			const auto evaluation = E();
+			file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+			file.write(reinterpret_cast<const char*>(&evaluation), sizeof(evaluation));
+			last = key;
+			size++;
+		}
+
+		UINT64 Close() {
+			file.seekp(0);
+			file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+			file.close();
+			return size;
+		}
+	};
+
+	//keys of a layer file are read in chunks, return false if the file is missing
+	template <typename F>
+	static bool ForEachChunk(const string& filename, F func) {
+		ifstream file(filename, std::ios::binary);
+		if (!file.is_open()) {
+			return false;
+		}
+		UINT64 size;
+		file.read(reinterpret_cast<char*>(&size), sizeof(size));
+		vector<Board> chunk;
+		for (UINT64 done = 0; done < size; ) {
+			chunk.resize(static_cast<size_t>(std::min<UINT64>(ENUMERATION_CHUNK_SIZE, size - done)));
+			for (auto& key : chunk) {
+				E evaluation;
+				file.read(reinterpret_cast<char*>(&key), sizeof(key));
+				file.read(reinterpret_cast<char*>(&evaluation), sizeof(evaluation));
+			}
+			func(chunk);
+			done += chunk.size();
+		}
+		file.close();
+		return true;
+	}
+
+	UINT64 Expand(const Step finishedStep) const {
+		Sorter sorter(KeyLess(), memory);
+		vector<vector<Board>> parts(std::max(1, threadNum));
+		ForEachChunk(RetrogradeSolver::LayerFilename(prefix, finishedStep), [&](const vector<Board>& chunk) {
+			for (auto& part : parts) {//a small chunk may not reach every part, so none keeps keys of the last chunk
+				part.clear();
+			}
+			RetrogradeSolver::Parallel(threadNum, chunk.size(), [&](const size_t begin, const size_t end, const size_t index) {
+				auto& part = parts[index];
+				for (auto i = begin; i < end; i++) {
+					RetrogradeSolver::ForEachChild(finishedStep, chunk[i], [&](const Board key, const bool terminal, const E&) {
+						if (!terminal) {
+							part.push_back(key);
+						}
+					});
+				}
+				std::sort(part.begin(), part.end());//fewer keys to push
+				part.erase(std::unique(part.begin(), part.end()), part.end());
+			});
+			for (const auto& part : parts) {//the sorter is not thread safe
+				for (const auto key : part) {
+					sorter.push(key);
+				}
+			}
+		});
+		sorter.sort();
+		LayerWriter writer(RetrogradeSolver::LayerFilename(prefix, finishedStep + 1));
+		for (; !sorter.empty(); ++sorter) {
+			writer.Push(*sorter);
+		}
+		return writer.Close();
+	}
+
+	void WriteCensus() const {
+		ofstream file(prefix + "census" + HELPER_FILE_EXTENSION);
+		for (const auto& item : Census) {
+			file << int(item.first) << " " << item.second << endl;
+		}
+		file.close();
+	}
+public:
+	vector<pair<Step, UINT64>> Census;//enumerated layer sizes
+
+	//memory is the bytes of the external sorter
+	LayerEnumerator(const string& _prefix, const size_t _memory, const int _threadNum) : prefix(_prefix), memory(_memory), threadNum(_threadNum) {}
+
+	//layers from the root step to the last non-terminal step are written to layer files, the census is written to a helper file
+	void Enumerate(const Step rootFinishedStep, const Board lastBoard, const Board currentBoard) {
+		assert(rootFinishedStep < MAX_STEP);
+		Census.clear();
+		LayerWriter root(RetrogradeSolver::LayerFilename(prefix, rootFinishedStep));
+		root.Push(RetrogradeSolver::RootKey(rootFinishedStep, lastBoard, currentBoard));
+		auto size = root.Close();
+		for (auto step = rootFinishedStep; ; step++) {
+			Census.emplace_back(step, size);
+			cout << "Enumerated step " << int(step) << ": " << size << " positions" << endl;
+			if (step + 1 >= MAX_STEP) {
+				break;
+			}
+			size = Expand(step);
+		}
+		WriteCensus();
+	}
+};
@@ -174,6 +174,15 @@ public:
 		}
 	}
 
+	//result known without playing to the end, e.g. from solved positions
+	StoneCountAlphaBetaEvaluation(const bool win, const Player _player, const Board _currentBoard) : StoneCountAlphaBetaEvaluation(false, MAX_STEP, _player, _currentBoard) {
+		if (win) {
+			Final.SelfWinAfterStep = MAX_STEP;//step is unknown, assume the latest
+		} else {
+			Final.OpponentWinAfterStep = MAX_STEP;
+		}
+	}
+
 	bool Validate() const {
 		return true;
 	}
@@ -4,6 +4,18 @@
 #include "eval.h"
 #include "storage_manager.h"
 #include "agent.h"
+#include "dfpn.h"
+
+//positions a solve keeps in the stores
+enum class KeptRecords : unsigned char {
+	All,
+	BlackWins,//only the positions one player wins, a proof tree of its win needs no others, the others are searched again when reached
+	WhiteWins,
+};
+
+inline bool Kept(const KeptRecords kept, const Player winner) {
+	return kept == KeptRecords::All || (kept == KeptRecords::BlackWins) == (winner == Player::Black);
+}
 
 class WinAlphaBetaAgent : public AlphaBetaAgent<WinEval> {
 public:
@@ -15,13 +27,14 @@ private:
 	mutable StorageManager<E> minimaxCaches;
 #endif
 	const Player player;
+	KeptRecords kept = KeptRecords::All;
 
 	inline bool reverse(const Step finishedStep) const {
 		auto queryPlayer = TurnUtil::WhoNext(finishedStep);
 		return queryPlayer != player;
 	}
 public:
-	WinAlphaBetaAgent(StorageManager<E>& _staticCaches, const Player _player, const bool& _token, const ActionSequence& _actionSequence = DEFAULT_ACTION_SEQUENCE) : AlphaBetaAgent<E>(_token, _actionSequence), caches(_staticCaches), player(_player)
+	WinAlphaBetaAgent(StorageManager<E>& _staticCaches, const Player _player, const atomic<bool>& _token, const ActionSequence& _actionSequence = DEFAULT_ACTION_SEQUENCE) : AlphaBetaAgent<E>(_token, _actionSequence), caches(_staticCaches), player(_player)
 #ifdef _DEBUG
 		, minimaxCaches("")
 #endif
@@ -49,12 +62,19 @@ public:
 	}
 
 	virtual void Set(const Step finishedStep, const Board board, const E& evaluation) override {
+		if (!Kept(kept, evaluation.Win() ? player : TurnUtil::Opponent(player))) {//evaluations are from the view of the root player
+			return;
+		}
 #ifdef _DEBUG
 		minimaxCaches.Set(finishedStep, board, evaluation);
 #endif
 		caches.Set(finishedStep, board, reverse(finishedStep) ? evaluation.OpponentView() : evaluation);
 	}
 
+	void SetKeptRecords(const KeptRecords _kept) {
+		kept = _kept;
+	}
+
 };
 
 template <typename E>
@@ -88,13 +108,19 @@ private:
 	Action opponentAction = Action::Pass;
 	bool getThisStateByOpponentPass = false;
 	bool hasKoAction = false;
+	Action koAction = Action::Pass;
+	int sharedFrom = -1;//actions from this index on are given to other workers
+	vector<int> deferred;//actions being searched by other threads, expanded again after all others
+	size_t nextDeferredIndex = 0;
+	Board marker = 0;//standard key marked as being searched, 0 if not marked, a marked position is never empty
+	vector<pair<bool, WinEval>> probes;//batch probe by action index before expanding: probed or not, and the record of a hit
 
 public:
 	Record<WinEval> Rec;
 
 	SearchState() = default;
 	SearchState(const Action _opponent, const Step _finishedStep, const Board _lastBoard, const Board _currentBoard, const ActionSequence* _actionSequencePtr) : getThisStateByOpponentPass(_opponent == Action::Pass), opponentAction(_opponent), finishedStep(_finishedStep), actionSequencePtr(_actionSequencePtr), currentBoard(_currentBoard) {
-		actions = LegalActionIterator::ListAll(TurnUtil::WhoNext(_finishedStep), _lastBoard, _currentBoard, _finishedStep == INITIAL_FINISHED_STEP, _actionSequencePtr, hasKoAction);
+		actions = LegalActionIterator::ListAll(TurnUtil::WhoNext(_finishedStep), _lastBoard, _currentBoard, _finishedStep == INITIAL_FINISHED_STEP, _actionSequencePtr, hasKoAction, koAction);
 	}
 
 	inline Step GetFinishedStep() const {
@@ -114,27 +140,128 @@ public:
 	}
 
 	bool Next(SearchState& next) {
-		if (nextActionIndex >= actions.size()) {
+		int index;
+		if (nextActionIndex < actions.size()) {
+			index = nextActionIndex++;
+		} else if (nextDeferredIndex < deferred.size()) {
+			index = deferred[nextDeferredIndex++];
+		} else {
 			return false;
 		}
-		auto& a = actions[nextActionIndex];
+		auto& a = actions[index];
 		next = SearchState(a.first, finishedStep + 1, currentBoard, a.second, actionSequencePtr);
-		nextActionIndex++;
+		return true;
+	}
+
+	//only an action of the first pass can be deferred
+	inline bool CanDefer() const {
+		return nextDeferredIndex == 0;
+	}
+
+	//the action got by last Next is expanded again after all others
+	inline void Defer() {
+		deferred.push_back(nextActionIndex - 1);
+	}
+
+	inline Board& Marker() {
+		return marker;
+	}
+
+	inline vector<pair<bool, WinEval>>& Probes() {
+		return probes;
+	}
+
+	//the batch probe of the action got by last Next, the record is uninitialized for a miss, an action expanded again after deferring is not reused
+	inline bool Probed(WinEval& record) const {
+		if (probes.empty() || nextDeferredIndex != 0 || !probes[nextActionIndex - 1].first) {
+			return false;
+		}
+		record = probes[nextActionIndex - 1].second;
 		return true;
 	}
 
 	inline bool HasKoAction() const {
 		return hasKoAction;
 	}
+
+	inline Board Key() const {
+		return PositionKey::Make(currentBoard, koAction, getThisStateByOpponentPass);
+	}
+
+	inline bool Fresh() const {
+		return nextActionIndex == 0;
+	}
+
+	inline int Expanded() const {
+		return nextActionIndex;
+	}
+
+	inline const vector<std::pair<Action, Board>>& Actions() const {
+		return actions;
+	}
+
+	//the later half of the actions not expanded yet, the next one is always kept, each action is shared once
+	vector<std::pair<Action, Board>> Share() {
+		const int end = sharedFrom < 0 ? static_cast<int>(actions.size()) : sharedFrom;
+		const int begin = std::max(nextActionIndex + 1, (nextActionIndex + end + 1) / 2);
+		if (begin >= end) {
+			return {};
+		}
+		sharedFrom = begin;
+		return vector<std::pair<Action, Board>>(actions.begin() + begin, actions.begin() + end);
+	}
+};
+
+//root of a sub tree of the full search, never finished by 2 passings
+class SearchTask {
+public:
+	Step FinishedStep = INITIAL_FINISHED_STEP;
+	Board LastBoard = EMPTY_BOARD;
+	Board CurrentBoard = EMPTY_BOARD;
+	Action OpponentAction = Action::Pass;
+
+	SearchTask() = default;
+	SearchTask(const Step _finishedStep, const Board _lastBoard, const Board _currentBoard, const Action _opponentAction) : FinishedStep(_finishedStep), LastBoard(_lastBoard), CurrentBoard(_currentBoard), OpponentAction(_opponentAction) {}
+
+	Board Key() const {
+		bool ko;
+		Action koAction;
+		LegalActionIterator::ListAll(TurnUtil::WhoNext(FinishedStep), LastBoard, CurrentBoard, FinishedStep == INITIAL_FINISHED_STEP, &DEFAULT_ACTION_SEQUENCE, ko, koAction);
+		return PositionKey::Standard(PositionKey::Make(CurrentBoard, koAction, OpponentAction == Action::Pass));
+	}
+};
+
+//receives sub trees given away by a running searcher
+class SearchTaskSink {
+public:
+	virtual bool Hungry() const = 0;
+	virtual void Donate(const SearchTask& task) = 0;
+};
+
+enum class LeafSolver : unsigned char {
+	AlphaBeta,
+	ProofNumber,
 };
 
 class FullSearcher {
 private:
 	StorageManager<WinEval>& Store;
 	const ActionSequence& actionSequence;
-	const bool& Token;
+	const atomic<bool>* token;
 	const Step& startCutOffFinishedStep;
 	const Step& startMiniMaxFinishedStep;
+	const LeafSolver& leafSolver;
+	const size_t proofTableCapacity;
+	const Step& splitDepth;
+	const bool& extendedKeys;
+	const bool& enhancedCutOff;
+	const KeptRecords& keptRecords;
+	std::unique_ptr<ProofNumberSearcher> prover;//created on first use, table is kept between sub trees
+	SearchStatistics statistics;
+	StatisticsSnapshot* snapshot;
+	const time_point<high_resolution_clock> created = high_resolution_clock::now();
+	SearchTask task;
+	vector<SearchState> stack;//kept when stopped by the token, so the search can be resumed in place
 
 	inline static void Update(Record<WinEval>& current, const Action action, const Record<WinEval>& after) {
 		auto temp = after.Eval.OpponentView();
@@ -143,57 +270,287 @@ private:
 			current.Eval = temp;
 		}
 	}
-public:
-	FullSearcher(StorageManager<WinEval>& _store, const ActionSequence& _actionSequence, const Step& _startMiniMaxFinishedStep, const Step& _startCutOffFinishedStep, const bool& _token) : Store(_store), actionSequence(_actionSequence), startMiniMaxFinishedStep(_startMiniMaxFinishedStep), startCutOffFinishedStep(_startCutOffFinishedStep), Token(_token){}
+	//probe all children in the store before expanding any of them, return true if one of them is a known loss of the opponent
+	//otherwise the results are kept in the state, so the children are not probed again when expanded
+	bool EnhancedTranspositionCutOff(SearchState& current) {
+		const Step nextFinishedStep = current.GetFinishedStep() + 1;
+		const auto currentBoard = current.GetCurrentBoard();
+		const auto& actions = current.Actions();
+		vector<size_t> indices;
+		vector<Board> boards;
+		for (size_t i = 0; i < actions.size(); i++) {
+			const auto& a = actions[i];
+			if (a.first == Action::Pass && current.GetThisStateByOpponentPassing()) {//may finish by 2 passings
+				continue;
+			}
+			if (a.second != currentBoard && __builtin_popcountll(Field::OccupyField(a.second)) == __builtin_popcountll(Field::OccupyField(currentBoard))) {//may have ko action after capturing one stone
+				continue;
+			}
+			indices.push_back(i);
+			boards.push_back(a.second);
+		}
+		vector<WinEval> records;
+		vector<bool> hits;
+		const auto hitCount = Store.GetBatch(nextFinishedStep, boards, records, hits);
+		statistics.StoreProbes += boards.size();
+		statistics.StoreHits += hitCount;
+		for (size_t i = 0; i < boards.size(); i++) {
+			if (hits[i] && !records[i].Win()) {
+				Update(current.Rec, actions[indices[i]].first, Record<WinEval>(records[i]));
+				return true;
+			}
+		}
+		auto& probes = current.Probes();
+		probes.assign(actions.size(), std::make_pair(false, WinEval()));
+		for (size_t i = 0; i < boards.size(); i++) {
+			if (!extendedKeys || actions[indices[i]].first != Action::Pass) {//an extended key of a passing child is not its board
+				probes[indices[i]] = std::make_pair(true, hits[i] ? records[i] : WinEval());
+			}
+		}
+		return false;
+	}
+
+	void Publish() {
+		statistics.Seconds = std::chrono::duration<double>(high_resolution_clock::now() - created).count();
+		if (snapshot != nullptr) {
+			snapshot->Store(statistics);
+		}
+	}
 
-	void Start() {
-		vector<SearchState> stack;
+	//give the unexpanded actions of the shallowest frame that has some to the sink
+	void Share(SearchTaskSink& sink) {
+		for (auto& frame : stack) {
+			const Step nextFinishedStep = frame.GetFinishedStep() + 1;
+			if (nextFinishedStep >= MAX_STEP || frame.Rec.Eval.GoodEnough()) {
+				continue;
+			}
+			auto shared = false;
+			for (const auto& a : frame.Share()) {
+				if (a.first == Action::Pass && frame.GetThisStateByOpponentPassing()) {
+					continue;
+				}
+				sink.Donate(SearchTask(nextFinishedStep, frame.GetCurrentBoard(), a.second, a.first));
+				shared = true;
+			}
+			if (shared) {
+				return;
+			}
+		}
+	}
+public:
+	FullSearcher(StorageManager<WinEval>& _store, const ActionSequence& _actionSequence, const Step& _startMiniMaxFinishedStep, const Step& _startCutOffFinishedStep, const LeafSolver& _leafSolver, const size_t _proofTableCapacity, const Step& _splitDepth, const bool& _extendedKeys, const bool& _enhancedCutOff, const KeptRecords& _keptRecords, const atomic<bool>& _token, StatisticsSnapshot* const _snapshot = nullptr) : Store(_store), actionSequence(_actionSequence), token(&_token), startCutOffFinishedStep(_startCutOffFinishedStep), startMiniMaxFinishedStep(_startMiniMaxFinishedStep), leafSolver(_leafSolver), proofTableCapacity(_proofTableCapacity), splitDepth(_splitDepth), extendedKeys(_extendedKeys), enhancedCutOff(_enhancedCutOff), keptRecords(_keptRecords), snapshot(_snapshot) {
 		stack.reserve(MAX_STEP + 1);
-		stack.emplace_back(Action::Pass, INITIAL_FINISHED_STEP, EMPTY_BOARD, EMPTY_BOARD, &actionSequence);
-		while (!stack.empty() && !Token) {
+	}
+
+	const SearchStatistics& Statistics() const {
+		return statistics;
+	}
+
+	//only when not searching, a suspended searcher can be resumed by another worker with its token
+	void Bind(const atomic<bool>& _token, StatisticsSnapshot* const _snapshot) {
+		if (token != &_token) {
+			prover = nullptr;//holds the old token
+		}
+		token = &_token;
+		snapshot = _snapshot;
+	}
+
+	void Bind(const FullSearcher& other) {
+		Bind(*other.token, other.snapshot);
+	}
+
+	inline bool Stopped() const {
+		return token->load(std::memory_order_relaxed);
+	}
+
+	//stopped by the token in the middle of a search
+	inline bool Suspended() const {
+		return !stack.empty();
+	}
+
+	inline const SearchTask& Task() const {
+		return task;
+	}
+
+	bool Start() {
+		return Start(SearchTask());
+	}
+
+	//search the sub tree and store its root, return false if stopped by the token, then it can be resumed
+	//if a sink is given, unexpanded actions are shared with it when it is hungry
+	bool Start(const SearchTask& _task, SearchTaskSink* const sink = nullptr) {
+		task = _task;
+		stack.clear();
+		stack.emplace_back(task.OpponentAction, task.FinishedStep, task.LastBoard, task.CurrentBoard, &actionSequence);
+		statistics.Node(task.FinishedStep);
+		return Run(sink);
+	}
+
+	//continue a suspended search, return false if stopped by the token again
+	bool Resume(SearchTaskSink* const sink = nullptr) {
+		assert(Suspended());
+		for (auto& state : stack) {
+			if (state.Marker() != 0) {
+				Store.Enter(state.GetFinishedStep(), state.Marker());
+			}
+		}
+		return Run(sink);
+	}
+
+	bool Run(SearchTaskSink* const sink) {
+		UINT64 iteration = 0;
+		while (!stack.empty() && !Stopped()) {
+			if ((++iteration & 0xFFF) == 0) {
+				Publish();
+				if (sink != nullptr && sink->Hungry()) {
+					Share(*sink);
+				}
+			}
 			auto& current = stack.back();
 			const Step finishedStep = current.GetFinishedStep();
-			const bool noninitialStep = finishedStep >= 1;
-			SearchState* const ancestor = noninitialStep ? &stack.rbegin()[1] : nullptr;
-			auto specialTermination = noninitialStep && current.GetOpponentAction() == Action::Pass && ancestor->GetOpponentAction() == Action::Pass;
+			const bool hasAncestor = stack.size() >= 2;//root of the sub tree has no ancestor
+			SearchState* const ancestor = hasAncestor ? &stack.rbegin()[1] : nullptr;
+			auto specialTermination = hasAncestor && current.GetOpponentAction() == Action::Pass && ancestor->GetOpponentAction() == Action::Pass;
 			const auto doNotCutOff = finishedStep < startCutOffFinishedStep;
 			if (specialTermination || finishedStep == MAX_STEP) {//current == Black, min == White
+				statistics.TwoPassTerminations += specialTermination;
 				current.Rec.BestActionIsPass = false;
 				auto player = TurnUtil::WhoNext(finishedStep);
 				current.Rec.Eval = WinEval(player, current.GetCurrentBoard());
 			} else {
 				if (doNotCutOff || !current.Rec.Eval.GoodEnough()) {
 					if (finishedStep >= startMiniMaxFinishedStep) {
-						auto player = TurnUtil::WhoNext(finishedStep);
-						auto agent = WinAlphaBetaAgent(Store, player, Token, actionSequence);
-						auto result = agent.AlphaBeta(finishedStep, noninitialStep ? ancestor->GetCurrentBoard() : EMPTY_BOARD, current.GetCurrentBoard());
+						const auto lastBoard = hasAncestor ? ancestor->GetCurrentBoard() : task.LastBoard;
+						pair<Action, WinEval> result;
+						if (leafSolver == LeafSolver::ProofNumber) {
+							if (prover == nullptr) {
+								prover = std::make_unique<ProofNumberSearcher>(Store, actionSequence, proofTableCapacity, *token);
+							}
+							const auto nodes = prover->Nodes;
+							result = prover->Solve(finishedStep, lastBoard, current.GetCurrentBoard());
+							statistics.Nodes += prover->Nodes - nodes;
+						}
+						if (leafSolver != LeafSolver::ProofNumber || (!Stopped() && !result.second.Initialized())) {//a root the prover leaves unsolved is searched by alpha-beta
+							auto player = TurnUtil::WhoNext(finishedStep);
+							auto agent = WinAlphaBetaAgent(Store, player, *token, actionSequence);
+							agent.SetSplitDepth(splitDepth);
+							agent.SetExtendedKeys(extendedKeys);
+							agent.SetEnhancedTranspositionCutOff(enhancedCutOff);
+							agent.SetKeptRecords(keptRecords);
+							result = agent.AlphaBeta(finishedStep, lastBoard, current.GetCurrentBoard());
+							statistics.Merge(agent.Statistics(), finishedStep);//plies of the leaf search start from this step
+						}
+						if (Stopped()) {//result is not valid, the leaf is searched again when resumed
+							break;
+						}
 						current.Rec.BestActionIsPass = result.first == Action::Pass;
 						current.Rec.Eval = result.second;
+					} else if (!doNotCutOff && enhancedCutOff && current.Fresh() && EnhancedTranspositionCutOff(current)) {
+						statistics.Cut(false);
 					} else {
 						SearchState after;
 						if (current.Next(after)) {
 							WinEval fetch;
-							if (doNotCutOff || (current.GetThisStateByOpponentPassing() && after.GetOpponentAction() == Action::Pass) || after.HasKoAction() || !Store.Get(after.GetFinishedStep(), after.GetCurrentBoard(), fetch)) {//always check 2 passings before lookup => we can use records only if we do not want to or cannot finish game now by 2 passings
+							const auto lookup = !doNotCutOff && !(current.GetThisStateByOpponentPassing() && after.GetOpponentAction() == Action::Pass) && (extendedKeys || !after.HasKoAction());//always check 2 passings before lookup => we can use records only if we do not want to or cannot finish game now by 2 passings
+							const auto probed = lookup && current.Probed(fetch);
+							const auto hit = probed ? fetch.Initialized() : lookup && Store.Get(after.GetFinishedStep(), extendedKeys ? after.Key() : after.GetCurrentBoard(), fetch);
+							if (lookup && !probed) {
+								statistics.Probe(hit);
+							}
+							if (!hit && lookup && Store.MarkersEnabled()) {
+								const auto marker = PositionKey::Standard(extendedKeys ? after.Key() : after.GetCurrentBoard());
+								if (current.CanDefer() && Store.Busy(after.GetFinishedStep(), marker)) {//come back after other siblings, the result may be stored by then
+									current.Defer();
+									statistics.DeferredBusy++;
+									continue;
+								}
+								Store.Enter(after.GetFinishedStep(), marker);
+								after.Marker() = marker;
+							}
+							if (!hit) {
 								stack.emplace_back(after);
+								statistics.Node(after.GetFinishedStep());
 							} else {//proceed
 								Update(current.Rec, after.GetOpponentAction(), fetch);
 							}
 							continue;
 						}
 					}
+				} else if (current.Expanded() < current.Actions().size()) {
+					statistics.Cut(current.Expanded() == 1);
 				}
 			}
 			//normal update ancestor
-			if (noninitialStep) {
+			if (hasAncestor) {
 				Update(ancestor->Rec, current.GetOpponentAction(), current.Rec);
 			}
 			//store record
-			assert(current.Rec.Eval.Initialized() || Token);
-			if (!specialTermination && !current.HasKoAction() && !(current.GetThisStateByOpponentPassing() && current.Rec.BestActionIsPass) && !Token) {//do not store success by using 2 passings => we can use stored records iff we are not taking advantage of opponent's passing mistake (or our dead ends)
+			assert(current.Rec.Eval.Initialized());
+			statistics.KoBlockedStores += !specialTermination && current.HasKoAction() && !extendedKeys;
+			const auto kept = Kept(keptRecords, current.Rec.Eval.Win() ? TurnUtil::WhoNext(finishedStep) : TurnUtil::Opponent(TurnUtil::WhoNext(finishedStep)));
+			if (kept && !specialTermination && !current.HasKoAction() && !(current.GetThisStateByOpponentPassing() && current.Rec.BestActionIsPass)) {//do not store success by using 2 passings => we can use stored records iff we are not taking advantage of opponent's passing mistake (or our dead ends)
 				Store.Set(finishedStep, current.GetCurrentBoard(), current.Rec.Eval);
 			}
+			if (kept && !specialTermination && extendedKeys && current.Key() != current.GetCurrentBoard()) {//ko point and passing are part of the key, so any result is exact
+				Store.Set(finishedStep, current.Key(), current.Rec.Eval);
+			}
+			if (current.Marker() != 0) {
+				Store.Leave(finishedStep, current.Marker());
+			}
 			stack.pop_back();
 		}
+		for (auto& state : stack) {//stopped by the token, markers are entered again when resumed
+			if (state.Marker() != 0) {
+				Store.Leave(state.GetFinishedStep(), state.Marker());
+			}
+		}
+		Publish();
+		return stack.empty();
 	}
 
+};
+
+//searchers stopped in the middle of a search, any worker can resume them
+class SuspendedSearchers {
+private:
+	std::mutex mutex;
+	vector<std::unique_ptr<FullSearcher>> searchers;
+public:
+	void Put(std::unique_ptr<FullSearcher>&& searcher) {
+		assert(searcher->Suspended());
+		std::lock_guard<std::mutex> lock(mutex);
+		searchers.push_back(std::move(searcher));
+	}
+
+	//the searcher taken is still bound to the old token
+	bool Take(std::unique_ptr<FullSearcher>& searcher) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (searchers.empty()) {
+			return false;
+		}
+		searcher = std::move(searchers.back());
+		searchers.pop_back();
+		return true;
+	}
+
+	//replace an idle searcher of a worker by a suspended one, bound to the same token
+	bool Adopt(std::unique_ptr<FullSearcher>& searcher) {
+		std::unique_ptr<FullSearcher> suspended;
+		if (!Take(suspended)) {
+			return false;
+		}
+		suspended->Bind(*searcher);
+		searcher = std::move(suspended);
+		return true;
+	}
+
+	size_t Size() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return searchers.size();
+	}
+
+	void Clear() {
+		std::lock_guard<std::mutex> lock(mutex);
+		searchers.clear();
+	}
 };
\ No newline at end of file
@@ -313,6 +313,19 @@ private:
 		}
 	}
 
+	inline int StandardIndexWithKo(const Action koAction) const {
+		auto index = 0;
+		auto result = std::make_pair(Boards[0], koAction);
+		for (auto i = 1; i < 8; i++) {
+			const auto candidate = std::make_pair(Boards[i], TranslateAction(i, koAction));
+			if (candidate < result) {
+				result = candidate;
+				index = i;
+			}
+		}
+		return index;
+	}
+
 public:
 	array<Board, 8> Boards;//R0, R90, R180, R270, T, TR90, TR180, TR270;
 
@@ -347,6 +360,51 @@ public:
 		auto index = find - Boards.begin();
 		return ReverseTranslateAction(index, action);
 	}
+
+	//board and ko point under the same symmetry, symmetric boards are told apart by the ko point
+	inline std::pair<Board, Action> StandardBoardWithKo(const Action koAction) const {
+		const auto index = StandardIndexWithKo(koAction);
+		return std::make_pair(Boards[index], TranslateAction(index, koAction));
+	}
+
+	//an action of the position given by StandardBoardWithKo, on this board
+	inline Action ReverseActionWithKo(const Action koAction, const Action standardAction) const {
+		return ReverseTranslateAction(StandardIndexWithKo(koAction), standardAction);
+	}
+};
+
+//storage keys of positions which need more than the board, stores are per step so the step field is free
+//ko point index + 1 in the step field, opponent passed flag above it, a key without both is the board itself
+const static UINT64 KEY_KO_SHIFT = STEP_SHIFT;
+const static State KEY_PASS = 1ull << EMPTY_SHIFT;
+
+class PositionKey {
+public:
+	inline static Board Make(const Board board, const Action koAction, const bool getThisByOpponentPass) {
+		auto key = Field::BoardField(board);
+		if (koAction != Action::Pass) {
+			key |= static_cast<Board>(__builtin_ctzll(static_cast<UINT64>(koAction)) + 1) << KEY_KO_SHIFT;
+		}
+		if (getThisByOpponentPass) {
+			key |= KEY_PASS;
+		}
+		return key;
+	}
+
+	inline static bool Extended(const Board key) {
+		return key != Field::BoardField(key);
+	}
+
+	inline static Board Standard(const Board key) {
+		const auto isomorphism = Isomorphism(key);
+		const auto koField = Field::StepField(key);
+		if (koField == 0) {//the pass flag does not change under symmetry
+			return isomorphism.StandardBoard() | (key & KEY_PASS);
+		}
+		const auto koAction = static_cast<Action>(1ull << ((koField >> KEY_KO_SHIFT) - 1));
+		const auto standard = isomorphism.StandardBoardWithKo(koAction);
+		return Make(standard.first, standard.second, (key & KEY_PASS) != 0);
+	}
 };
 
 class Capture {
@@ -425,6 +483,79 @@ public:
 	}
 };
 
+//masks of plain 25 bit position sets
+const static Board BIT_FULL = PLAYER_FIELD_MASK;
+const static Board BIT_LEFT_COLUMN = 0x108421;
+const static Board BIT_RIGHT_COLUMN = BIT_LEFT_COLUMN << (BOARD_SIZE - 1);
+const static Board BIT_TOP_ROW = (1 << BOARD_SIZE) - 1;
+const static Board BIT_BOTTOM_ROW = BIT_TOP_ROW << (BOARD_SIZE * (BOARD_SIZE - 1));
+
+//group and liberty operations on position sets, without queues
+class BitBoardUtil {
+public:
+	inline static Board Stones(const Board board, const Player player) {
+		const auto occupied = Field::OccupyField(board) >> OCCUPY_SHIFT;
+		return player == Player::White ? board & occupied & BIT_FULL : occupied & ~board;
+	}
+
+	inline static Board Compose(const Board black, const Board white) {
+		return white | ((black | white) << OCCUPY_SHIFT);
+	}
+
+	//orthogonal neighbours of all positions in the set
+	inline static Board Spread(const Board set) {
+		return (((set << 1) & ~BIT_LEFT_COLUMN) | ((set >> 1) & ~BIT_RIGHT_COLUMN) | (set << BOARD_SIZE) | (set >> BOARD_SIZE)) & BIT_FULL;
+	}
+
+	//connected positions of the seed inside the area
+	inline static Board Flood(const Board seed, const Board area) {
+		auto group = seed;
+		while (true) {
+			const auto next = (group | Spread(group)) & area;
+			if (next == group) {
+				return group;
+			}
+			group = next;
+		}
+	}
+
+	inline static Board Liberties(const Board group, const Board empty) {
+		return Spread(group) & empty;
+	}
+
+	//empty positions whose orthogonal neighbours are all own stones
+	inline static Board Eyes(const Board own, const Board empty) {
+		const auto up = (own << BOARD_SIZE) | BIT_TOP_ROW;
+		const auto down = (own >> BOARD_SIZE) | BIT_BOTTOM_ROW;
+		const auto left = (own << 1) | BIT_LEFT_COLUMN;
+		const auto right = (own >> 1) | BIT_RIGHT_COLUMN;
+		return empty & up & down & left & right;
+	}
+
+	//place a stone, remove captured opponent stones, false if suicide
+	inline static bool Place(Board& own, Board& opponent, const Board position) {
+		auto self = own | position;
+		auto other = opponent;
+		auto empty = ~(self | other) & BIT_FULL;
+		auto around = Spread(position) & other;
+		while (around != 0) {
+			const auto neighbour = around & (~around + 1);
+			const auto group = Flood(neighbour, other);
+			around &= ~group;
+			if (Liberties(group, empty) == 0) {
+				other &= ~group;
+				empty |= group;
+			}
+		}
+		if (Liberties(Flood(position, self), empty) == 0) {
+			return false;
+		}
+		own = self;
+		opponent = other;
+		return true;
+	}
+};
+
 class Rule {
 public:
 
@@ -465,6 +596,7 @@ private:
 
 	int nextActionIndex;
 	bool hasKoAction = false;
+	Action koAction = Action::Pass;
 
 	const ActionSequence* actions;
 
@@ -519,6 +651,9 @@ public:
 			bool ko;
 			auto available = TryAction(lastBoard, currentBoard, player, isFirstStep, action, ko, afterBoard);
 			hasKoAction = hasKoAction || ko;
+			if (ko) {
+				koAction = action;
+			}
 			if (available) {
 				return true;
 			}
@@ -531,7 +666,12 @@ public:
 		return hasKoAction;
 	}
 
-	static vector<std::pair<Action, Board>> ListAll(const Player player, const Board lastBoard, const Board currentBoard, const bool isFirstStep, const ActionSequence* actions, bool& ko) {
+	Action KoAction() const {//the only position forbidden by ko, pass if none
+		assert(nextActionIndex >= actions->size());
+		return koAction;
+	}
+
+	static vector<std::pair<Action, Board>> ListAll(const Player player, const Board lastBoard, const Board currentBoard, const bool isFirstStep, const ActionSequence* actions, bool& ko, Action& koAction) {
 		auto result = std::vector<std::pair<Action, Board>>();
 		auto iter = LegalActionIterator(player, lastBoard, currentBoard, isFirstStep, actions);
 		Action action;
@@ -540,9 +680,15 @@ public:
 			result.emplace_back(action, board);
 		}
 		ko = iter.HasKoAction();
+		koAction = iter.KoAction();
 		return result;
 	}
 
+	inline static vector<std::pair<Action, Board>> ListAll(const Player player, const Board lastBoard, const Board currentBoard, const bool isFirstStep, const ActionSequence* actions, bool& ko) {
+		Action koAction;
+		return ListAll(player, lastBoard, currentBoard, isFirstStep, actions, ko, koAction);
+	}
+
 	inline static vector<std::pair<Action, Board>> ListAll(const Player player, const Board lastBoard, const Board currentBoard, const bool isFirstStep, const ActionSequence* actions) {
 		bool ko;
 		return ListAll(player, lastBoard, currentBoard, isFirstStep, actions, ko);
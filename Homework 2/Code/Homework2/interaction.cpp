@@ -2,6 +2,9 @@
 #include "game_host.h"
 #include "agent.h"
 #include "best.h"
+#include "endgame_builder.h"
+#include "negamax.h"
+#include "mcts.h"
 
 using std::cin;
 #pragma region Play Game
@@ -22,16 +25,20 @@ public:
 
 void Search(const Step finishedStep, const Board lastBoard, const Board currentBoard) {
 	auto agent = AlphaBetaAgent<EvaluationTrace<StoneCountAlphaBetaEvaluation>>();
-	auto result = agent.Search(finishedStep, lastBoard, currentBoard);
+	auto result = agent.SearchBest(finishedStep, lastBoard, currentBoard);
 	auto player = TurnUtil::WhoNext(finishedStep);
-	const auto& eval = result.second.Dominance().GetFinal();
+	const auto& eval = result.front().second.Dominance().GetFinal();
 	if (eval.SelfWinAfterStep <= MAX_STEP) {
 		cout << (player == Player::Black ? "X" : "O") << " (you) will win after step " << int(eval.SelfWinAfterStep) << endl;
 	} 
 	if (eval.OpponentWinAfterStep <= MAX_STEP) {
 		cout << (player == Player::Black ? "O" : "X") << " (opponent) will win after step " << int(eval.OpponentWinAfterStep) << endl;
 	}
-	cout << "Your best action is: " << PlainAction(result.first).ToString() << endl;
+	cout << "Your best actions are:";
+	for (const auto& r : result) {
+		cout << " " << PlainAction(r.first).ToString();
+	}
+	cout << endl;
 }
 
 vector<Action> SafeActions(const Step finishedStep, const Board lastBoard, const Board currentBoard, const vector<Action>& bestActions) {
@@ -141,10 +148,72 @@ std::shared_ptr<StoneCountAlphaBetaAgent> SetStoneCountAlphaBetaAgent() {
 		cout << "Set Search Depth: ";
 		int depth;
 		cin >> depth;
-		return std::make_shared<StoneCountAlphaBetaAgent>(depth);
+		auto agent = std::make_shared<StoneCountAlphaBetaAgent>(depth);
+#ifdef PARALLEL_ALPHA_BETA
+		cout << "Set Split Depth: ";
+		int split;
+		cin >> split;
+		agent->SetSplitDepth(split);
+#endif
+		cout << "Set Late Move Index (0 to disable): ";
+		int lateMove;
+		cin >> lateMove;
+		if (lateMove > 0) {
+			cout << "Set Late Move Reduction: ";
+			int reduction;
+			cin >> reduction;
+			agent->SetLateMoveReduction(lateMove, reduction);
+		}
+		cout << "Set ProbCut Reduction (0 to disable, -1 for the calibrated one): ";
+		int probCut;
+		cin >> probCut;
+		if (probCut < 0) {
+			ProbCutParameters parameters;
+			if (!parameters.Load()) {
+				cout << "No calibrated ProbCut in " << PROBCUT_FILENAME << ", disabled" << endl;
+			}
+			agent->SetProbCut(parameters);
+		} else if (probCut > 0) {
+			cout << "Set ProbCut Min Remaining Depth: ";
+			int minDepth;
+			cin >> minDepth;
+			agent->SetProbCut(probCut, minDepth);
+		}
+		cout << "Set Quiescence Node Budget (0 to disable): ";
+		int budget;
+		cin >> budget;
+		agent->SetQuiescence(budget);
+		cout << "Set Truth Table Prefix (- to disable): ";
+		string prefix;
+		cin >> prefix;
+		if (prefix.compare("-") != 0) {
+			auto table = std::make_shared<const TruthTable>(prefix);
+			cout << "Truth table positions: " << table->Size() << endl;
+			agent->SetTruthTable(table);
+		}
+		return agent;
 	}
 }
 
+std::shared_ptr<Agent> SetNegamaxAgent(const NegamaxDriver driver) {
+	system("CLS");
+	cout << "Set Search Depth: ";
+	int depth;
+	cin >> depth;
+	return std::make_shared<StoneCountNegamaxAgent>(depth, driver);
+}
+
+std::shared_ptr<Agent> SetMctsAgent() {
+	system("CLS");
+	cout << "Set Move Time (ms): ";
+	int time;
+	cin >> time;
+	cout << "Set Thread Num: ";
+	int num;
+	cin >> num;
+	return std::make_shared<MctsAgent>(milliseconds(time), num);
+}
+
 std::shared_ptr<Agent> SelectAgent(const Player player) {
 	while (true) {
 		system("CLS");
@@ -154,6 +223,9 @@ std::shared_ptr<Agent> SelectAgent(const Player player) {
 		cout << "\t" << "3: Greedy" << endl;
 		cout << "\t" << "4: Aggressive" << endl;
 		cout << "\t" << "5: Alpha-Beta (Count Stone)" << endl;
+		cout << "\t" << "6: Negamax PVS (Count Stone)" << endl;
+		cout << "\t" << "7: Negamax MTD(f) (Count Stone)" << endl;
+		cout << "\t" << "8: Monte Carlo Tree Search" << endl;
 		//cout << "\t" << "6: Comprehensive (My Agent)" << endl;
 		char agent;
 		cin >> agent;
@@ -168,6 +240,12 @@ std::shared_ptr<Agent> SelectAgent(const Player player) {
 			return std::make_shared<AggressiveAgent>();
 		case '5':
 			return SetStoneCountAlphaBetaAgent();
+		case '6':
+			return SetNegamaxAgent(NegamaxDriver::PrincipalVariation);
+		case '7':
+			return SetNegamaxAgent(NegamaxDriver::MTDF);
+		case '8':
+			return SetMctsAgent();
 		//case '6':
 			//return std::make_shared<MyAgent>();
 		}
@@ -303,7 +381,121 @@ void ConvertBestAction() {
 	cout << "size limit: ";
 	int sizeLimit;
 	cin >> sizeLimit;
-	BestConverter::Convert(prefix, begin, end, sizeLimit);
+	cout << "search positions with missing children (0/1): ";
+	int resolve;
+	cin >> resolve;
+	BestResolver resolver = nullptr;
+	if (resolve != 0) {
+		resolver = [](const Step finishedStep, const Board board) {//only asked for positions without a ko action and not reached by a pass, so no last board restricts the actions
+			auto agent = AlphaBetaAgent<WinEval>();
+			vector<Action> result;
+			for (const auto& r : agent.SearchBest(finishedStep, EMPTY_BOARD, board)) {//ties of the best, all winning or all losing
+				if (r.second.GoodEnough()) {
+					result.push_back(r.first);
+				}
+			}
+			return result;
+		};
+	}
+	cout << "winning strategy only (0/1): ";
+	int proofTree;
+	cin >> proofTree;
+	if (proofTree != 0) {
+		BestConverter::ConvertProofTree(prefix, begin, end, sizeLimit, resolver);
+	} else {
+		BestConverter::Convert(prefix, begin, end, sizeLimit, resolver);
+	}
+}
+
+//plain alpha-beta searcher with a fixed depth limit for probing
+class ProbeAgent : public CachedAlphaBetaAgent<EvaluationTrace<StoneCountAlphaBetaEvaluation>> {
+public:
+	ProbeAgent(const Step depthLimit) {
+		DepthLimit = depthLimit;
+	}
+};
+
+//how often a shallow search orders two brother actions differently from the deep search, per remaining depth and reduction
+//a ProbCut with the same remaining depth and reduction would make a wrong cut in about the same rate
+//the parameters which keep the rate under the given limit are written for the agents
+void CalibrateProbCut() {
+	cout << "Corpus size: ";
+	int size;
+	cin >> size;
+	cout << "Max remaining depth: ";
+	int maxDepth;
+	cin >> maxDepth;
+	cout << "Max wrong cut rate (%): ";
+	double maxWrong;
+	cin >> maxWrong;
+	const auto maxReduction = 2;
+	vector<vector<double>> rates(maxDepth + 1, vector<double>(maxReduction + 1, -1.0));//in %, index by remaining depth and reduction, -1 if not measured
+	std::mt19937 rng(0);
+	vector<std::tuple<Step, Board, Board>> corpus;
+	while (corpus.size() < size) {//positions from random games
+		const Step stop = 2 + rng() % 15;
+		Board last = EMPTY_BOARD, current = EMPTY_BOARD;
+		for (Step step = 0; step < stop; step++) {
+			const auto actions = LegalActionIterator::ListAll(TurnUtil::WhoNext(step), last, current, step == INITIAL_FINISHED_STEP, &DEFAULT_ACTION_SEQUENCE);
+			last = current;
+			current = actions[rng() % actions.size()].second;
+		}
+		corpus.emplace_back(stop, last, current);
+	}
+	for (auto depth = 2; depth <= maxDepth; depth++) {
+		for (auto reduction = 1; reduction <= maxReduction && depth - 1 - reduction >= 1; reduction++) {
+			UINT64 pairs = 0;
+			UINT64 wrong = 0;
+			milliseconds deepTime(0), shallowTime(0);
+			for (const auto& position : corpus) {
+				const auto step = std::get<0>(position);
+				const auto current = std::get<2>(position);
+				const auto children = LegalActionIterator::ListAll(TurnUtil::WhoNext(step), std::get<1>(position), current, false, &DEFAULT_ACTION_SEQUENCE);
+				vector<EvaluationTrace<StoneCountAlphaBetaEvaluation>> deep, shallow;
+				for (const auto& child : children) {
+					auto start = high_resolution_clock::now();
+					deep.push_back(ProbeAgent(depth - 1).Search(step + 1, current, child.second).second);
+					auto middle = high_resolution_clock::now();
+					shallow.push_back(ProbeAgent(depth - 1 - reduction).Search(step + 1, current, child.second).second);
+					auto stop = high_resolution_clock::now();
+					deepTime += duration_cast<milliseconds>(middle - start);
+					shallowTime += duration_cast<milliseconds>(stop - middle);
+				}
+				for (auto i = 0; i < children.size(); i++) {
+					for (auto j = i + 1; j < children.size(); j++) {
+						const auto s = shallow[i].Compare(shallow[j]);
+						if (s == 0) {
+							continue;
+						}
+						const auto d = deep[i].Compare(deep[j]);
+						pairs++;
+						wrong += s > 0 ? d < 0 : d > 0;
+					}
+				}
+			}
+			rates[depth][reduction] = pairs == 0 ? 0.0 : 100.0 * wrong / pairs;
+			cout << "remaining depth " << depth << ", reduction " << reduction << ": wrong cut " << rates[depth][reduction] << "% of " << pairs << " pairs, shallow time " << shallowTime.count() << " ms, deep time " << deepTime.count() << " ms" << endl;
+		}
+	}
+	//the lowest min depth from which every measured remaining depth is under the limit, deeper ones are assumed no worse, then the largest reduction
+	ProbCutParameters parameters;
+	for (auto reduction = maxReduction; reduction >= 1; reduction--) {
+		auto minDepth = maxDepth + 1;
+		for (auto depth = maxDepth; depth >= reduction + 2 && rates[depth][reduction] >= 0 && rates[depth][reduction] <= maxWrong; depth--) {
+			minDepth = depth;
+		}
+		if (minDepth <= maxDepth && (parameters.Reduction == 0 || minDepth < parameters.MinDepth)) {
+			parameters.Reduction = static_cast<Step>(reduction);
+			parameters.MinDepth = static_cast<Step>(minDepth);
+		}
+	}
+	if (parameters.Reduction == 0) {
+		cout << "No reduction keeps wrong cuts under " << maxWrong << "%, ProbCut disabled" << endl;
+	} else {
+		cout << "ProbCut reduction " << static_cast<int>(parameters.Reduction) << ", min remaining depth " << static_cast<int>(parameters.MinDepth) << endl;
+	}
+	parameters.Save();
+	cout << "Written to " << PROBCUT_FILENAME << endl;
 }
 
 void LookupBestAction() {
@@ -323,12 +515,39 @@ void LookupBestAction() {
 	}
 }
 
+//roots from random games, the table is written for the agent
+void BuildEndgameTable() {
+	cout << "Root finished step: ";
+	int rootFinishedStep;
+	cin >> rootFinishedStep;
+	assert(0 < rootFinishedStep && rootFinishedStep < MAX_STEP);
+	cout << "Root count: ";
+	int count;
+	cin >> count;
+	cout << "Random seed: ";
+	unsigned int seed;
+	cin >> seed;
+	cout << "Max empty points (" << TOTAL_POSITIONS << " for all): ";
+	int maxEmptyCount;
+	cin >> maxEmptyCount;
+	cout << "Thread num: ";
+	int threadNum;
+	cin >> threadNum;
+	const auto start = high_resolution_clock::now();
+	EndgameBuilder builder(threadNum);
+	builder.Build(rootFinishedStep, EndgameBuilder::RandomRoots(rootFinishedStep, count, seed));
+	builder.Write(ENDGAME_FILENAME, maxEmptyCount);
+	cout << "Built in " << duration_cast<milliseconds>(high_resolution_clock::now() - start).count() << " ms" << endl;
+}
+
 int main(int argc, char* argv[]) {
 	cout << "Select function:" << endl;
 	cout << "\t" << "1: Play Game" << endl;
 	cout << "\t" << "2: Visualize Record" << endl;
 	cout << "\t" << "3: Convert best action" << endl;
 	cout << "\t" << "4: Lookup best action" << endl;
+	cout << "\t" << "5: Calibrate ProbCut" << endl;
+	cout << "\t" << "6: Build endgame table" << endl;
 	int i;
 	cin >> i;
 	system("CLS");
@@ -345,6 +564,12 @@ int main(int argc, char* argv[]) {
 	case 4:
 		LookupBestAction();
 		break;
+	case 5:
+		CalibrateProbCut();
+		break;
+	case 6:
+		BuildEndgameTable();
+		break;
 	}
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,193 @@
+//Name: Zongjian Li, USC ID: 6503378943
+#pragma once
+
+#include "go.h"
+#include "eval.h"
+#include "agent.h"
+
+#ifndef SEARCH_MODE
+
+//key layout: standard board, step field, remaining depth, bound type, valid flag
+const static UINT64 SHARED_DEPTH_SHIFT = 56;
+const static UINT64 SHARED_DEPTH_MASK = 0x1F;
+const static UINT64 SHARED_BOUND_SHIFT = 61;
+const static UINT64 SHARED_BOUND_MASK = 0x3;
+const static State SHARED_KEY_VALID = 1ull << 63;
+const static State SHARED_POSITION_MASK = (1ull << EMPTY_SHIFT) - 1;
+
+//lock-free table shared by all search threads, each entry is guarded by a sequence number
+//readers never wait and retry nothing (a torn read is a miss), writers skip an entry which is being written
+template <typename E>
+class SharedTable {
+private:
+	const static size_t WORDS = (sizeof(E) + sizeof(UINT64) - 1) / sizeof(UINT64);
+
+	struct Entry {
+		atomic<UINT32> Version;//odd while writing
+		atomic<UINT64> Key;
+		array<atomic<UINT64>, WORDS> Words;
+	};
+
+	std::unique_ptr<Entry[]> entries;
+	size_t mask;
+
+	inline static size_t Hash(const State position) {
+		auto h = position;
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdull;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ull;
+		h ^= h >> 33;
+		return static_cast<size_t>(h);
+	}
+
+	inline static State Position(const Step finishedStep, const Board standardBoard) {
+		return standardBoard | StepUtil::ConvertStepToStepField(finishedStep);
+	}
+
+	inline static Step Depth(const UINT64 key) {
+		return static_cast<Step>((key >> SHARED_DEPTH_SHIFT) & SHARED_DEPTH_MASK);
+	}
+public:
+	SharedTable(const size_t capacity) {
+		size_t size = 1;
+		while (size < capacity) {
+			size <<= 1;
+		}
+		entries = std::unique_ptr<Entry[]>(new Entry[size]);
+		for (size_t i = 0; i < size; i++) {
+			entries[i].Version.store(0, std::memory_order_relaxed);
+			entries[i].Key.store(0, std::memory_order_relaxed);
+		}
+		mask = size - 1;
+	}
+
+	//hit if the entry was searched at least as deep as required, bound is the type of the value as in the searcher
+	bool Get(const Step finishedStep, const Board board, const Step remainingDepth, E& evaluation, unsigned char& bound) const {
+		const auto position = Position(finishedStep, Isomorphism(board).StandardBoard());
+		const auto& entry = entries[Hash(position) & mask];
+		const auto version = entry.Version.load(std::memory_order_acquire);
+		if ((version & 1) != 0) {
+			return false;
+		}
+		const auto key = entry.Key.load(std::memory_order_relaxed);
+		if ((key & SHARED_KEY_VALID) == 0 || (key & SHARED_POSITION_MASK) != position || Depth(key) < remainingDepth) {
+			return false;
+		}
+		array<UINT64, WORDS> buffer;
+		for (size_t i = 0; i < WORDS; i++) {
+			buffer[i] = entry.Words[i].load(std::memory_order_relaxed);
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (entry.Version.load(std::memory_order_relaxed) != version) {
+			return false;
+		}
+		std::memcpy(static_cast<void*>(&evaluation), buffer.data(), sizeof(E));
+		bound = static_cast<unsigned char>((key >> SHARED_BOUND_SHIFT) & SHARED_BOUND_MASK);
+		return true;
+	}
+
+	//deeper results of the same position are kept
+	void Set(const Step finishedStep, const Board board, const Step remainingDepth, const E& evaluation, const unsigned char bound) {
+		const auto position = Position(finishedStep, Isomorphism(board).StandardBoard());
+		auto& entry = entries[Hash(position) & mask];
+		auto version = entry.Version.load(std::memory_order_relaxed);
+		if ((version & 1) != 0 || !entry.Version.compare_exchange_strong(version, version + 1, std::memory_order_acquire)) {
+			return;
+		}
+		std::atomic_thread_fence(std::memory_order_release);
+		const auto old = entry.Key.load(std::memory_order_relaxed);
+		if ((old & SHARED_KEY_VALID) == 0 || (old & SHARED_POSITION_MASK) != position || Depth(old) <= remainingDepth) {
+			array<UINT64, WORDS> buffer{};
+			std::memcpy(buffer.data(), &evaluation, sizeof(E));
+			for (size_t i = 0; i < WORDS; i++) {
+				entry.Words[i].store(buffer[i], std::memory_order_relaxed);
+			}
+			entry.Key.store(position | (static_cast<State>(remainingDepth) << SHARED_DEPTH_SHIFT) | (static_cast<State>(bound) << SHARED_BOUND_SHIFT) | SHARED_KEY_VALID, std::memory_order_relaxed);
+		}
+		entry.Version.store(version + 2, std::memory_order_release);
+	}
+};
+
+class LazySmpAgent : public AlphaBetaAgent<EvaluationTrace<StoneCountAlphaBetaEvaluation>> {
+public:
+	using E = EvaluationTrace<StoneCountAlphaBetaEvaluation>;
+private:
+	SharedTable<E>& table;
+
+	inline Step RemainingDepth(const Step finishedStep, const int depth) const {//searching beyond the end of game is the same, reduced nodes have less
+		return static_cast<Step>(std::max(0, std::min(static_cast<int>(DepthLimit) - depth, MAX_STEP - static_cast<int>(finishedStep))));
+	}
+protected:
+	//every node is shared with its bound, not only the ones searched without a window, so helpers also share their cut-offs
+	virtual bool GetBound(const Step finishedStep, const Board board, const int depth, E& evaluation, Bound& bound) const override {
+		unsigned char type;
+		if (!table.Get(finishedStep, board, RemainingDepth(finishedStep, depth), evaluation, type)) {
+			return false;
+		}
+		bound = static_cast<Bound>(type);
+		return true;
+	}
+
+	virtual void SetBound(const Step finishedStep, const Board board, const int depth, const E& evaluation, const Bound bound) override {
+		table.Set(finishedStep, board, RemainingDepth(finishedStep, depth), evaluation, static_cast<unsigned char>(bound));
+	}
+public:
+	LazySmpAgent(const Step _depthLimit, SharedTable<E>& _table, const ActionSequence& _actionSequence = DEFAULT_ACTION_SEQUENCE, const atomic<bool>* _stopToken = nullptr) : AlphaBetaAgent<E>(_actionSequence), table(_table) {
+		DepthLimit = _depthLimit;
+		BoundedTable = true;
+		SetStopToken(_stopToken);
+	}
+};
+
+//helper threads run the same iterative deepening with shuffled action sequences and fill the shared table
+//the caller keeps searching on its own thread with agents from MainAgent and uses its own result
+class LazySmp {
+private:
+	using E = LazySmpAgent::E;
+
+	SharedTable<E> table;
+	atomic<bool> stop;
+	vector<std::unique_ptr<thread>> helpers;
+	vector<ActionSequence> sequences;
+
+	void Help(const int id, const Step finishedStep, const Board lastBoard, const Board currentBoard, const int startDepth) {
+		const auto maxDepth = MAX_STEP - finishedStep;
+		for (auto depth = startDepth + (id & 1); depth <= maxDepth && !stop.load(std::memory_order_relaxed); depth++) {//half of the helpers search one step deeper
+			LazySmpAgent agent(depth, table, sequences[id], &stop);
+			agent.Search(finishedStep, lastBoard, currentBoard);
+		}
+	}
+public:
+	LazySmp(const int helperNum, const size_t tableCapacity, const unsigned int seed) : table(tableCapacity), sequences(helperNum, DEFAULT_ACTION_SEQUENCE) {
+		stop.store(false);
+		std::mt19937 rng(seed);
+		for (auto& sequence : sequences) {
+			std::shuffle(sequence.begin(), sequence.end(), rng);
+		}
+	}
+
+	~LazySmp() {
+		Stop();
+	}
+
+	void Start(const Step finishedStep, const Board lastBoard, const Board currentBoard, const int startDepth) {
+		for (size_t i = 0; i < sequences.size(); i++) {
+			helpers.push_back(std::unique_ptr<thread>(new thread(&LazySmp::Help, this, i, finishedStep, lastBoard, currentBoard, startDepth)));
+		}
+	}
+
+	void Stop() {
+		stop.store(true);
+		for (auto& t : helpers) {
+			t->join();
+		}
+		helpers.clear();
+	}
+
+	std::shared_ptr<Agent> MainAgent(const Step depth, const ActionSequence& sequence) {
+		return std::make_shared<LazySmpAgent>(depth, table, sequence);
+	}
+};
+
+#endif
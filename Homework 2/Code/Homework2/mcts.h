@@ -0,0 +1,385 @@
+//Name: Zongjian Li, USC ID: 6503378943
+#pragma once
+
+#include "go.h"
+#include "agent.h"
+#include "playout.h"
+
+typedef UINT32 NodeIndex;
+
+const static NodeIndex NULL_NODE = std::numeric_limits<NodeIndex>::max();
+
+const static unsigned char MCTS_LEAF = 0;
+const static unsigned char MCTS_EXPANDING = 1;
+const static unsigned char MCTS_EXPANDED = 2;
+
+class MctsNode {
+public:
+	Board Current = EMPTY_BOARD;
+	Action Act = Action::Pass;
+	Step FinishedStep = INITIAL_FINISHED_STEP;
+	bool GetThisByOpponentPass = false;
+	bool Terminal = false;
+	unsigned char ChildCount = 0;
+	NodeIndex FirstChild = NULL_NODE;//children are allocated contiguously
+	atomic<unsigned char> Expansion;
+	atomic<UINT32> Visits;
+	atomic<UINT32> Wins;//for the player who moved into this node
+	atomic<UINT32> VirtualLoss;
+
+	void Reset(const Action _act, const Step _finishedStep, const Board _current, const bool _getThisByOpponentPass, const bool _terminal) {
+		Current = _current;
+		Act = _act;
+		FinishedStep = _finishedStep;
+		GetThisByOpponentPass = _getThisByOpponentPass;
+		Terminal = _terminal;
+		ChildCount = 0;
+		FirstChild = NULL_NODE;
+		Expansion.store(MCTS_LEAF, std::memory_order_relaxed);
+		Visits.store(0, std::memory_order_relaxed);
+		Wins.store(0, std::memory_order_relaxed);
+		VirtualLoss.store(0, std::memory_order_relaxed);
+	}
+
+	void CopyFrom(const MctsNode& other) {//without children, only called when no search is running
+		Reset(other.Act, other.FinishedStep, other.Current, other.GetThisByOpponentPass, other.Terminal);
+		Visits.store(other.Visits.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		Wins.store(other.Wins.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+};
+
+//nodes are never freed one by one, the whole arena is cleared or compacted between moves
+class MctsArena {
+private:
+	std::unique_ptr<MctsNode[]> nodes;
+	const size_t capacity;
+	atomic<size_t> used;
+public:
+	MctsArena(const size_t _capacity) : nodes(new MctsNode[_capacity]), capacity(_capacity) {
+		used.store(0);
+	}
+
+	NodeIndex Allocate(const size_t count) {//NULL_NODE if full
+		auto begin = used.fetch_add(count, std::memory_order_relaxed);
+		if (begin + count > capacity) {
+			return NULL_NODE;
+		}
+		return static_cast<NodeIndex>(begin);
+	}
+
+	inline MctsNode& operator [] (const NodeIndex index) {
+		return nodes[index];
+	}
+
+	void Clear() {
+		used.store(0);
+	}
+
+	size_t Size() const {
+		return std::min(used.load(), capacity);
+	}
+};
+
+//tree parallel UCT, threads share one tree and spread out by virtual loss
+class MctsAgent : public Agent {
+private:
+	const milliseconds budget;
+	const int threadNum;
+	const double exploration;
+	const ActionSequence& actionSequence;
+
+	std::unique_ptr<MctsArena> arena;
+	std::unique_ptr<MctsArena> spare;
+	NodeIndex root = NULL_NODE;
+	Board rootLast = EMPTY_BOARD;
+
+	bool Expand(const NodeIndex index, const Board lastBoard) {
+		auto& node = (*arena)[index];
+		auto expected = MCTS_LEAF;
+		if (!node.Expansion.compare_exchange_strong(expected, MCTS_EXPANDING, std::memory_order_acquire)) {
+			return false;
+		}
+		const auto player = TurnUtil::WhoNext(node.FinishedStep);
+		const auto actions = LegalActionIterator::ListAll(player, lastBoard, node.Current, node.FinishedStep == INITIAL_FINISHED_STEP, &actionSequence);
+		const auto first = arena->Allocate(actions.size());
+		if (first == NULL_NODE) {
+			node.Expansion.store(MCTS_LEAF, std::memory_order_release);
+			return false;
+		}
+		const Step nextFinishedStep = node.FinishedStep + 1;
+		for (size_t i = 0; i < actions.size(); i++) {
+			const auto& a = actions[i];
+			const auto pass = a.first == Action::Pass;
+			(*arena)[first + i].Reset(a.first, nextFinishedStep, a.second, pass, (node.GetThisByOpponentPass && pass) || nextFinishedStep == MAX_STEP);
+		}
+		node.FirstChild = first;
+		node.ChildCount = static_cast<unsigned char>(actions.size());
+		node.Expansion.store(MCTS_EXPANDED, std::memory_order_release);
+		return true;
+	}
+
+	NodeIndex Select(const NodeIndex index) {
+		auto& node = (*arena)[index];
+		const auto parentVisits = node.Visits.load(std::memory_order_relaxed) + node.VirtualLoss.load(std::memory_order_relaxed);
+		const auto logVisits = std::log(static_cast<double>(std::max<UINT32>(parentVisits, 1)));
+		auto best = node.FirstChild;
+		auto bestScore = -std::numeric_limits<double>::infinity();
+		for (NodeIndex i = node.FirstChild; i < node.FirstChild + node.ChildCount; i++) {
+			auto& child = (*arena)[i];
+			const auto visits = child.Visits.load(std::memory_order_relaxed) + child.VirtualLoss.load(std::memory_order_relaxed);
+			if (visits == 0) {
+				best = i;
+				break;
+			}
+			const auto score = static_cast<double>(child.Wins.load(std::memory_order_relaxed)) / visits + exploration * std::sqrt(logVisits / visits);//virtual loss counts as lost visits
+			if (score > bestScore) {
+				bestScore = score;
+				best = i;
+			}
+		}
+		(*arena)[best].VirtualLoss.fetch_add(1, std::memory_order_relaxed);
+		return best;
+	}
+
+	void Iterate(vector<NodeIndex>& path, PlayoutKernel& playout) {
+		path.clear();
+		auto index = root;
+		auto lastBoard = rootLast;
+		path.push_back(index);
+		while (!(*arena)[index].Terminal) {
+			auto& node = (*arena)[index];
+			if (node.Expansion.load(std::memory_order_acquire) != MCTS_EXPANDED) {
+				if ((index != root && node.Visits.load(std::memory_order_relaxed) == 0) || !Expand(index, lastBoard)) {
+					break;
+				}
+			}
+			lastBoard = node.Current;
+			index = Select(index);
+			path.push_back(index);
+		}
+		const auto& leaf = (*arena)[index];
+		const auto winner = leaf.Terminal ? Score::Winner(leaf.Current).first : playout.Run(leaf.FinishedStep, lastBoard, leaf.Current, leaf.GetThisByOpponentPass);
+		for (const auto i : path) {
+			auto& node = (*arena)[i];
+			if (winner != TurnUtil::WhoNext(node.FinishedStep)) {
+				node.Wins.fetch_add(1, std::memory_order_relaxed);
+			}
+			node.Visits.fetch_add(1, std::memory_order_relaxed);
+			if (i != root) {
+				node.VirtualLoss.fetch_sub(1, std::memory_order_relaxed);
+			}
+		}
+		Playouts.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void Run(const time_point<high_resolution_clock> deadline, const unsigned int seed) {
+		PlayoutKernel playout(seed);
+		vector<NodeIndex> path;
+		path.reserve(MAX_STEP + 1);
+		do {//at least expand the root
+			Iterate(path, playout);
+		} while (high_resolution_clock::now() < deadline);
+	}
+
+	//copy the sub tree to the spare arena, breadth first so siblings stay contiguous
+	void Compact(const NodeIndex newRoot) {
+		spare->Clear();
+		root = spare->Allocate(1);
+		(*spare)[root].CopyFrom((*arena)[newRoot]);
+		std::queue<pair<NodeIndex, NodeIndex>> queue;
+		queue.emplace(newRoot, root);
+		while (!queue.empty()) {
+			const auto from = queue.front().first;
+			const auto to = queue.front().second;
+			queue.pop();
+			const auto& source = (*arena)[from];
+			if (source.Expansion.load() != MCTS_EXPANDED) {
+				continue;
+			}
+			const auto first = spare->Allocate(source.ChildCount);
+			if (first == NULL_NODE) {
+				continue;
+			}
+			for (auto i = 0; i < source.ChildCount; i++) {
+				(*spare)[first + i].CopyFrom((*arena)[source.FirstChild + i]);
+				queue.emplace(source.FirstChild + i, first + i);
+			}
+			auto& target = (*spare)[to];
+			target.FirstChild = first;
+			target.ChildCount = source.ChildCount;
+			target.Expansion.store(MCTS_EXPANDED);
+		}
+		std::swap(arena, spare);
+	}
+
+	//the new position is a child or grandchild of the last root
+	bool Reuse(const Step finishedStep, const Board lastBoard, const Board currentBoard) {
+		if (root == NULL_NODE) {
+			return false;
+		}
+		vector<pair<NodeIndex, Board>> frontier = { std::make_pair(root, rootLast) };
+		for (auto depth = 0; depth < 2; depth++) {
+			vector<pair<NodeIndex, Board>> next;
+			for (const auto& f : frontier) {
+				const auto& node = (*arena)[f.first];
+				if (node.FinishedStep == finishedStep && node.Current == currentBoard && f.second == lastBoard) {
+					Compact(f.first);
+					return true;
+				}
+				if (node.Expansion.load() != MCTS_EXPANDED) {
+					continue;
+				}
+				for (NodeIndex i = node.FirstChild; i < node.FirstChild + node.ChildCount; i++) {
+					next.emplace_back(i, node.Current);
+				}
+			}
+			frontier = std::move(next);
+		}
+		for (const auto& f : frontier) {
+			const auto& node = (*arena)[f.first];
+			if (node.FinishedStep == finishedStep && node.Current == currentBoard && f.second == lastBoard) {
+				Compact(f.first);
+				return true;
+			}
+		}
+		return false;
+	}
+
+public:
+	atomic<UINT64> Playouts;
+
+	//a sub tree written by an earlier process, Act drops it if the position is not in it
+	void Read(const string& filename) {
+		ifstream file(filename, std::ios::binary);
+		if (!file.is_open()) {
+			return;
+		}
+		UINT64 count = 0;
+		Board last;
+		file.read(reinterpret_cast<char*>(&count), sizeof(count));
+		file.read(reinterpret_cast<char*>(&last), sizeof(last));
+		arena->Clear();
+		root = NULL_NODE;
+		const auto first = file && count > 0 ? arena->Allocate(count) : NULL_NODE;
+		if (first == NULL_NODE) {
+			arena->Clear();
+			return;
+		}
+		for (NodeIndex i = first; i < first + count; i++) {
+			Board current;
+			Action act;
+			Step finishedStep;
+			bool getThisByOpponentPass;
+			bool terminal;
+			unsigned char childCount;
+			NodeIndex firstChild;
+			UINT32 visits;
+			UINT32 wins;
+			file.read(reinterpret_cast<char*>(&current), sizeof(current));
+			file.read(reinterpret_cast<char*>(&act), sizeof(act));
+			file.read(reinterpret_cast<char*>(&finishedStep), sizeof(finishedStep));
+			file.read(reinterpret_cast<char*>(&getThisByOpponentPass), sizeof(getThisByOpponentPass));
+			file.read(reinterpret_cast<char*>(&terminal), sizeof(terminal));
+			file.read(reinterpret_cast<char*>(&childCount), sizeof(childCount));
+			file.read(reinterpret_cast<char*>(&firstChild), sizeof(firstChild));
+			file.read(reinterpret_cast<char*>(&visits), sizeof(visits));
+			file.read(reinterpret_cast<char*>(&wins), sizeof(wins));
+			auto& node = (*arena)[i];
+			node.Reset(act, finishedStep, current, getThisByOpponentPass, terminal);
+			if (childCount > 0) {
+				node.ChildCount = childCount;
+				node.FirstChild = firstChild;
+				node.Expansion.store(MCTS_EXPANDED, std::memory_order_relaxed);
+			}
+			node.Visits.store(visits, std::memory_order_relaxed);
+			node.Wins.store(wins, std::memory_order_relaxed);
+		}
+		if (!file) {
+			arena->Clear();
+			return;
+		}
+		root = first;
+		rootLast = last;
+	}
+
+	//keep the sub tree after the action taken for the next process, at most limit nodes breadth first,
+	//nodes whose children are cut off are written as leaves
+	void Write(const string& filename, const Action action, const size_t limit) {
+		if (root == NULL_NODE || (*arena)[root].Expansion.load() != MCTS_EXPANDED) {
+			return;
+		}
+		const auto& node = (*arena)[root];
+		auto next = NULL_NODE;
+		for (NodeIndex i = node.FirstChild; i < node.FirstChild + node.ChildCount; i++) {
+			if ((*arena)[i].Act == action) {
+				next = i;
+			}
+		}
+		if (next == NULL_NODE) {
+			return;
+		}
+		const auto last = node.Current;
+		Compact(next);
+		rootLast = last;
+		const UINT64 count = std::min(arena->Size(), limit);
+		ofstream file(filename, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+		file.write(reinterpret_cast<const char*>(&rootLast), sizeof(rootLast));
+		for (NodeIndex i = root; i < root + count; i++) {
+			const auto& n = (*arena)[i];
+			const auto kept = n.Expansion.load() == MCTS_EXPANDED && n.FirstChild + n.ChildCount <= count;
+			const unsigned char childCount = kept ? n.ChildCount : 0;
+			const NodeIndex firstChild = kept ? n.FirstChild : NULL_NODE;
+			const UINT32 visits = n.Visits.load();
+			const UINT32 wins = n.Wins.load();
+			file.write(reinterpret_cast<const char*>(&n.Current), sizeof(n.Current));
+			file.write(reinterpret_cast<const char*>(&n.Act), sizeof(n.Act));
+			file.write(reinterpret_cast<const char*>(&n.FinishedStep), sizeof(n.FinishedStep));
+			file.write(reinterpret_cast<const char*>(&n.GetThisByOpponentPass), sizeof(n.GetThisByOpponentPass));
+			file.write(reinterpret_cast<const char*>(&n.Terminal), sizeof(n.Terminal));
+			file.write(reinterpret_cast<const char*>(&childCount), sizeof(childCount));
+			file.write(reinterpret_cast<const char*>(&firstChild), sizeof(firstChild));
+			file.write(reinterpret_cast<const char*>(&visits), sizeof(visits));
+			file.write(reinterpret_cast<const char*>(&wins), sizeof(wins));
+		}
+		file.close();
+	}
+
+	MctsAgent(const milliseconds _budget, const int _threadNum = 1, const size_t _capacity = 1 << 20, const double _exploration = 1.0, const ActionSequence& _actionSequence = DEFAULT_ACTION_SEQUENCE) : budget(_budget), threadNum(_threadNum), exploration(_exploration), actionSequence(_actionSequence), arena(new MctsArena(_capacity)), spare(new MctsArena(_capacity)) {
+		Playouts.store(0);
+	}
+
+	virtual Action Act(const Step finishedStep, const Board lastBoard, const Board currentBoard) override {
+		const auto deadline = high_resolution_clock::now() + budget;
+		if (!Reuse(finishedStep, lastBoard, currentBoard)) {
+			arena->Clear();
+			root = arena->Allocate(1);
+			const auto getThisByOpponentPass = finishedStep != INITIAL_FINISHED_STEP && lastBoard == currentBoard;
+			(*arena)[root].Reset(Action::Pass, finishedStep, currentBoard, getThisByOpponentPass, finishedStep == MAX_STEP);
+		}
+		rootLast = lastBoard;
+		Playouts.store(0);
+		vector<std::unique_ptr<thread>> helpers;
+		for (auto i = 1; i < threadNum; i++) {
+			helpers.push_back(std::unique_ptr<thread>(new thread(&MctsAgent::Run, this, deadline, static_cast<unsigned int>(std::random_device()() + i))));
+		}
+		Run(deadline, std::random_device()());
+		for (auto& t : helpers) {
+			t->join();
+		}
+		const auto& node = (*arena)[root];
+		if (node.Expansion.load() != MCTS_EXPANDED) {
+			return Action::Pass;
+		}
+		auto best = node.FirstChild;
+		for (NodeIndex i = node.FirstChild; i < node.FirstChild + node.ChildCount; i++) {
+			if ((*arena)[i].Visits.load() > (*arena)[best].Visits.load()) {
+				best = i;
+			}
+		}
+#ifdef INTERACT_MODE
+		cout << "MCTS playouts: " << Playouts.load() << ", tree nodes: " << arena->Size() << endl;
+#endif
+		return (*arena)[best].Act;
+	}
+};
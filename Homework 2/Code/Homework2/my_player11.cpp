@@ -3,6 +3,10 @@
 #include "agent.h"
 #include "visualization.h"
 #include "best.h"
+#include "endgame.h"
+#include "negamax.h"
+#include "lazy_smp.h"
+#include "mcts.h"
 
 
 /*===================================================================================================================//
@@ -15,6 +19,12 @@
 
 //#define GRADING
 #define SUBMISSION
+//#define NEGAMAX
+//#define LAZY_SMP //needs -pthread on old gcc
+//#define MCTS
+//#define SELECTIVE_SEARCH
+//#define QUIESCENCE
+//#define TRUTH_LEAVES
 
 const static string INPUT_FILENAME = "input.txt";
 const static string OUTPUT_FILENAME = "output.txt";
@@ -33,6 +43,33 @@ const static float TRY_NEXT_DEPTH_THRESHOLD_FACTOR = 0.2;
 const static array<Step, TOTAL_POSITIONS> SAFE_SEARCH_DEPTH = {/*0*/ 3, 3, 3, 3, 3,/*5*/ 4, 4, 4, 4, 4, /*10*/5, 5, 5, 5, 5, /*15*/5, 5, 5, 5, 5, /*20*/255, 255, 255, 255, 255 };
 const static int FORCE_FULL_SEARCH_STEP = 15;
 
+#ifdef SELECTIVE_SEARCH
+const static Step LATE_MOVE_INDEX = 3;
+const static Step LATE_MOVE_REDUCTION = 1;
+const static Step PROBCUT_REDUCTION = 1;//replaced by the calibrated ones in PROBCUT_FILENAME if written
+const static Step PROBCUT_MIN_DEPTH = 4;
+#endif
+
+#ifdef QUIESCENCE
+const static int QUIESCENCE_BUDGET = 64;//nodes beyond each leaf
+#endif
+
+#ifdef TRUTH_LEAVES
+const static string TRUTH_TABLE_PREFIX = "step_";//solved win/loss files, probed inside the search
+std::shared_ptr<const TruthTable> truthTable;
+#endif
+
+#ifdef MCTS
+const static int MCTS_THREAD_NUM = 1;//more threads need -pthread on old gcc
+const static string MCTS_TREE_FILENAME = "mcts" + HELPER_FILE_EXTENSION;//each move is a new process, the sub tree after the move is kept for the next one
+const static size_t MCTS_KEPT_NODES = 1 << 18;
+#endif
+
+#ifdef LAZY_SMP
+const static size_t LAZY_SMP_TABLE_CAPACITY = 1 << 15;
+std::unique_ptr<LazySmp> lazySmp;
+#endif
+
 inline milliseconds MoveRemainingTime(const int currentGame, const int finishedStep, const milliseconds lastAccumulate, const milliseconds moveTime) {
 	auto newAverageMoveTimeLimit = duration_cast<milliseconds>(AVERAGE_MOVE_TIME_LIMIT) * (MOVE_EACH_GAME * (currentGame - 1) + finishedStep / 2 + 1) - lastAccumulate - moveTime;
 	return std::min(newAverageMoveTimeLimit, duration_cast<milliseconds>(SINGLE_MOVE_TIME_LIMIT) - moveTime);
@@ -282,8 +319,39 @@ EndingInfo Ending(const milliseconds lastAccumulate, const time_point<high_resol
 	return EndingInfo(write_safe, moveTime, accumulate);
 }
 
+std::shared_ptr<Agent> SearchAgent(const Step depth, const ActionSequence& sequence) {
+#if defined(LAZY_SMP)
+	return lazySmp->MainAgent(depth, sequence);
+#elif defined(NEGAMAX)
+	return std::make_shared<StoneCountNegamaxAgent>(depth, NegamaxDriver::MTDF, sequence);
+#else
+	auto agent = std::make_shared<StoneCountAlphaBetaAgent>(depth, sequence);
+#ifdef SELECTIVE_SEARCH
+	agent->SetLateMoveReduction(LATE_MOVE_INDEX, LATE_MOVE_REDUCTION);
+	ProbCutParameters probCut;
+	probCut.Reduction = PROBCUT_REDUCTION;
+	probCut.MinDepth = PROBCUT_MIN_DEPTH;
+	probCut.Load();//calibrated ones if the file is there
+	agent->SetProbCut(probCut);
+#endif
+#ifdef QUIESCENCE
+	agent->SetQuiescence(QUIESCENCE_BUDGET);
+#endif
+#ifdef TRUTH_LEAVES
+	agent->SetTruthTable(truthTable);
+#endif
+	return agent;
+#endif
+}
+
 bool TryAgent(const milliseconds lastAccumulate, const int gameCount, const time_point<high_resolution_clock>& start, const Step finishedStep, const Input& input, std::shared_ptr<Agent>& agent) {
 	auto action = agent->Act(finishedStep, input.Last, input.Current);
+#ifndef SUBMISSION
+	const auto alphaBeta = std::dynamic_pointer_cast<AlphaBetaAgent<EvaluationTrace<StoneCountAlphaBetaEvaluation>>>(agent);
+	if (alphaBeta != nullptr) {
+		alphaBeta->Statistics().Print("Search statistics");
+	}
+#endif
 	auto info = Ending(lastAccumulate, start, input, action);
 	return info.WriteSafe && info.MoveTime < MoveRemainingTime(gameCount, finishedStep, lastAccumulate, info.MoveTime) * TRY_NEXT_DEPTH_THRESHOLD_FACTOR;
 }
@@ -363,6 +431,49 @@ int main(int argc, char* argv[]) {
 		}
 	}
 
+	//endgame, only a win is played, a loss is still searched for the most stones
+	{
+		const EndgameTable endgame;
+		bool win;
+		Action action;
+		if (endgame.Find(finishedStep, input.Last, input.Current, win, action) && win) {
+			auto safe = SafeActions(finishedStep, input.Last, input.Current, { action });
+			if (safe.first) {
+#ifndef SUBMISSION
+				cout << "---------- endgame ----------" << endl;
+#endif
+				Ending(trueAccumulate, start, input, safe.second);
+				return 0;
+			}
+		}
+	}
+
+#ifdef MCTS
+	{
+		const auto elapsed = duration_cast<milliseconds>(high_resolution_clock::now() - start);
+		const auto budget = std::min(MoveRemainingTime(gameCount, finishedStep, trueAccumulate, elapsed), SAFE_WRITE_STEP_TIME_LIMIT - elapsed) - MOVE_RESERVED_TIME;
+		MctsAgent agent(budget, MCTS_THREAD_NUM, 1 << 20, 1.0, sequence);
+		agent.Read(MCTS_TREE_FILENAME);
+		const auto action = agent.Act(finishedStep, input.Last, input.Current);
+		Ending(trueAccumulate, start, input, action);
+		agent.Write(MCTS_TREE_FILENAME, action, MCTS_KEPT_NODES);
+		return 0;
+	}
+#endif
+
+#ifdef TRUTH_LEAVES
+	truthTable = std::make_shared<const TruthTable>(TRUTH_TABLE_PREFIX, finishedStep + 1, finishedStep + SAFE_SEARCH_DEPTH[finishedStep] + 1);//each move is a new process, only the steps of the safe and the next depth are loaded
+#ifndef SUBMISSION
+	cout << "Truth table positions: " << truthTable->Size() << endl;
+#endif
+#endif
+
+#ifdef LAZY_SMP
+	const auto hardware = static_cast<int>(thread::hardware_concurrency());
+	lazySmp = std::unique_ptr<LazySmp>(new LazySmp(std::max(hardware - 1, 0), LAZY_SMP_TABLE_CAPACITY, time(NULL)));
+	lazySmp->Start(finishedStep, input.Last, input.Current, SAFE_SEARCH_DEPTH[finishedStep] + 1);
+#endif
+
 	//try
 	std::shared_ptr<Agent> pAgent;
 	//safe guard
@@ -372,7 +483,7 @@ int main(int argc, char* argv[]) {
 #ifndef SUBMISSION
 		cout << "-------- safe guard --------" << endl;
 #endif
-		pAgent = std::make_shared<StoneCountAlphaBetaAgent>(safeDepth, sequence);
+		pAgent = SearchAgent(safeDepth, sequence);
 		doIter = TryAgent(trueAccumulate, gameCount, start, finishedStep, input, pAgent);
 	}
 
@@ -388,12 +499,12 @@ int main(int argc, char* argv[]) {
 			do {
 				estimate = finishedStep < FORCE_FULL_SEARCH_STEP && (finishedStep + depth) < MAX_STEP;
 				if (estimate) {
-					pAgent = std::make_shared<StoneCountAlphaBetaAgent>(depth, sequence);//TODO: keep loaded evaluation in memory
+					pAgent = SearchAgent(depth, sequence);//TODO: keep loaded evaluation in memory
 #ifndef SUBMISSION
 					cout << "------ search depth: " << depth << " ------" << endl;
 #endif
 				} else {
-					pAgent = std::make_shared<StoneCountAlphaBetaAgent>(MAX_STEP, sequence);//do not use win-step agent, I want it still estimate even if it must lose
+					pAgent = SearchAgent(MAX_STEP, sequence);//do not use win-step agent, I want it still estimate even if it must lose
 #ifndef SUBMISSION
 					cout << "------ full search ------" << endl;
 #endif
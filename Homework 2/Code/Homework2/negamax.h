@@ -0,0 +1,281 @@
+//Name: Zongjian Li, USC ID: 6503378943
+#pragma once
+
+#include "go.h"
+#include "agent.h"
+
+typedef int NegamaxValue;
+
+const static NegamaxValue NEGAMAX_INFINITY = 1 << 20;
+const static NegamaxValue NEGAMAX_WIN = 1 << 16;
+
+enum class NodeType : unsigned char {
+	PV,
+	NonPV,//searched with a null window, cut and all nodes are searched the same way
+};
+
+//children types are resolved at compile time, so the inner loop has no mode checks
+template <NodeType T>
+class Node;
+
+template <>
+class Node<NodeType::PV> {
+public:
+	static constexpr bool IsPV = true;
+	static constexpr NodeType First = NodeType::PV;
+	static constexpr NodeType Later = NodeType::NonPV;//null window, re-search as PV on fail-high
+};
+
+template <>
+class Node<NodeType::NonPV> {
+public:
+	static constexpr bool IsPV = false;
+	static constexpr NodeType First = NodeType::NonPV;
+	static constexpr NodeType Later = NodeType::NonPV;
+};
+
+enum class NegamaxDriver : unsigned char {
+	PrincipalVariation,
+	MTDF,
+};
+
+//values are always from the view of the player to move
+class WinNegamaxEvaluation {
+public:
+	inline static NegamaxValue Final(const Step finishedStep, const Player player, const Board board) {
+		return Score::Winner(board).first == player ? NEGAMAX_WIN : -NEGAMAX_WIN;
+	}
+
+	inline static NegamaxValue Heuristic(const Player player, const Board board) {
+		return 0;
+	}
+};
+
+class StoneCountNegamaxEvaluation {
+private:
+	const static NegamaxValue STONE_WEIGHT = 2 * TOTAL_POSITIONS + 1;//territory advantage only breaks ties
+public:
+	inline static NegamaxValue Final(const Step finishedStep, const Player player, const Board board) {
+		auto value = NEGAMAX_WIN - static_cast<NegamaxValue>(finishedStep);//win earlier, lose later
+		return Score::Winner(board).first == player ? value : -value;
+	}
+
+	inline static NegamaxValue Heuristic(const Player player, const Board board) {
+		const auto stones = Score::PartialScore(board);
+		const auto territory = Score::PartialScore(Score::FillEmptyPositions(board));
+		const auto stoneAdvantage = static_cast<NegamaxValue>(stones.Black) - static_cast<NegamaxValue>(stones.White);
+		const auto territoryAdvantage = static_cast<NegamaxValue>(territory.Black) - static_cast<NegamaxValue>(territory.White);
+		const auto value = stoneAdvantage * STONE_WEIGHT + territoryAdvantage;
+		return player == Player::Black ? value : -value;
+	}
+};
+
+template <typename V>
+class NegamaxAgent : public Agent {
+private:
+	enum class Bound : unsigned char {
+		Exact,
+		Lower,
+		Upper,
+	};
+
+	class TableEntry {
+	public:
+		NegamaxValue Value = 0;
+		Bound Type = Bound::Exact;
+		Step Depth = 0;
+		Action Best = Action::Pass;//standard orientation
+	};
+
+	const ActionSequence& actionSequence;
+	const NegamaxDriver driver;
+	array<std::unordered_map<Board, TableEntry>, MAX_STEP + 1> table;
+
+	inline bool Probe(const Step finishedStep, const Isomorphism& iso, const Board standardBoard, TableEntry& entry, Action& bestAction) const {
+		const auto& t = table[finishedStep];
+		const auto find = t.find(standardBoard);
+		if (find == t.end()) {
+			return false;
+		}
+		entry = find->second;
+		bestAction = iso.ReverseAction(standardBoard, entry.Best);
+		return true;
+	}
+
+	inline void Store(const Step finishedStep, const Isomorphism& iso, const NegamaxValue value, const Bound type, const int remaining, const Action bestAction) {
+		const auto standard = iso.StandardBoard(bestAction);
+		auto& entry = table[finishedStep][standard.first];
+		if (entry.Depth > remaining) {
+			return;//keep deeper result
+		}
+		entry.Value = value;
+		entry.Type = type;
+		entry.Depth = static_cast<Step>(remaining);
+		entry.Best = standard.second;
+	}
+
+	template <NodeType T>
+	NegamaxValue Search(
+		const int remaining,
+		const Step finishedStep, const bool isFirstStep,
+		const Board lastBoard, const Board currentBoard,
+		const bool getThisByOpponentPass, const bool consecutivePass,
+		NegamaxValue alpha, const NegamaxValue beta,
+		Action& bestAction)
+	{
+		Nodes++;
+		const auto player = TurnUtil::WhoNext(finishedStep);
+		if (finishedStep == MAX_STEP || consecutivePass) {
+			return V::Final(finishedStep, player, currentBoard);
+		}
+		bool hasKoAction;
+		auto allActions = LegalActionIterator::ListAll(player, lastBoard, currentBoard, isFirstStep, &actionSequence, hasKoAction);
+		const auto storable = !hasKoAction && !getThisByOpponentPass;
+		const auto iso = Isomorphism(currentBoard);
+		const auto standardBoard = iso.StandardBoard();
+		auto hashAction = Action::Pass;
+		auto hasHashAction = false;
+		if (storable) {
+			TableEntry entry;
+			if (Probe(finishedStep, iso, standardBoard, entry, hashAction)) {
+				hasHashAction = true;
+				if (!Node<T>::IsPV && entry.Depth >= remaining) {
+					if (entry.Type == Bound::Exact || (entry.Type == Bound::Lower && entry.Value >= beta) || (entry.Type == Bound::Upper && entry.Value <= alpha)) {
+						bestAction = hashAction;
+						return entry.Value;
+					}
+				}
+			}
+		}
+		if (remaining <= 0 && lastBoard != currentBoard) {
+			return V::Heuristic(player, currentBoard);
+		}
+		if (hasHashAction) {//hash move first
+			auto find = std::find_if(allActions.begin(), allActions.end(), [&](const std::pair<Action, Board>& a) { return a.first == hashAction; });
+			if (find != allActions.end()) {
+				std::rotate(allActions.begin(), find, find + 1);
+			}
+		}
+		const auto originalAlpha = alpha;
+		const auto nextFinishedStep = static_cast<Step>(finishedStep + 1);
+		auto best = -NEGAMAX_INFINITY;
+		bestAction = allActions.front().first;
+		for (size_t i = 0; i < allActions.size(); i++) {
+			const auto& action = allActions[i];
+			const auto nextGetThisByOpponentPass = action.first == Action::Pass;
+			const auto nextConsecutivePass = getThisByOpponentPass && nextGetThisByOpponentPass;
+			Action childAction;
+			NegamaxValue value;
+			if (i == 0) {
+				value = -Search<Node<T>::First>(remaining - 1, nextFinishedStep, false, currentBoard, action.second, nextGetThisByOpponentPass, nextConsecutivePass, -beta, -alpha, childAction);
+			} else {
+				value = -Search<Node<T>::Later>(remaining - 1, nextFinishedStep, false, currentBoard, action.second, nextGetThisByOpponentPass, nextConsecutivePass, -alpha - 1, -alpha, childAction);
+				if (Node<T>::IsPV && value > alpha && value < beta) {
+					value = -Search<NodeType::PV>(remaining - 1, nextFinishedStep, false, currentBoard, action.second, nextGetThisByOpponentPass, nextConsecutivePass, -beta, -alpha, childAction);
+				}
+			}
+			if (value > best) {
+				best = value;
+				bestAction = action.first;
+			}
+			if (best > alpha) {
+				alpha = best;
+			}
+			if (alpha >= beta) {
+				break;
+			}
+		}
+		if (storable) {
+			const auto type = best <= originalAlpha ? Bound::Upper : (best >= beta ? Bound::Lower : Bound::Exact);
+			Store(finishedStep, iso, best, type, remaining, bestAction);
+		}
+		return best;
+	}
+
+	NegamaxValue PrincipalVariation(const int remaining, const Step finishedStep, const bool isFirstStep, const Board lastBoard, const Board currentBoard, const bool getThisByOpponentPass, Action& bestAction) {
+		return Search<NodeType::PV>(remaining, finishedStep, isFirstStep, lastBoard, currentBoard, getThisByOpponentPass, false, -NEGAMAX_INFINITY, NEGAMAX_INFINITY, bestAction);
+	}
+
+	NegamaxValue MTDF(const int remaining, const Step finishedStep, const bool isFirstStep, const Board lastBoard, const Board currentBoard, const bool getThisByOpponentPass, NegamaxValue guess, Action& bestAction) {
+		auto lower = -NEGAMAX_INFINITY;
+		auto upper = NEGAMAX_INFINITY;
+		auto failedHigh = false;
+		while (lower < upper) {
+			const auto beta = guess == lower ? guess + 1 : guess;
+			Action action;
+			guess = Search<NodeType::NonPV>(remaining, finishedStep, isFirstStep, lastBoard, currentBoard, getThisByOpponentPass, false, beta - 1, beta, action);
+			if (guess < beta) {
+				upper = guess;
+				if (!failedHigh) {
+					bestAction = action;
+				}
+			} else {
+				lower = guess;
+				failedHigh = true;
+				bestAction = action;//only a fail-high proves the move
+			}
+		}
+		return guess;
+	}
+
+protected:
+	Step DepthLimit = std::numeric_limits<Step>::max();
+
+public:
+	UINT64 Nodes = 0;
+
+	NegamaxAgent(const Step _depthLimit, const NegamaxDriver _driver = NegamaxDriver::MTDF, const ActionSequence& _actionSequence = DEFAULT_ACTION_SEQUENCE) : actionSequence(_actionSequence), driver(_driver), DepthLimit(_depthLimit) {}
+
+	pair<Action, NegamaxValue> Search(const Step finishedStep, const Board lastBoard, const Board currentBoard) {
+		for (auto& t : table) {
+			t.clear();
+		}
+		Nodes = 0;
+		const auto player = MyPlayer(finishedStep);
+		const auto isFirstStep = IsFirstStep(player, lastBoard, currentBoard);
+		const auto getThisByOpponentPass = !isFirstStep && lastBoard == currentBoard;
+		const auto maxDepth = std::min(static_cast<int>(DepthLimit), MAX_STEP - finishedStep);//deeper limits are the same as unlimited
+		auto bestAction = Action::Pass;
+		NegamaxValue value = 0;
+		for (auto depth = 1; depth <= maxDepth; depth++) {//iterative deepening, shallower results order moves and seed the guess
+			switch (driver) {
+			case NegamaxDriver::PrincipalVariation:
+				value = PrincipalVariation(depth, finishedStep, isFirstStep, lastBoard, currentBoard, getThisByOpponentPass, bestAction);
+				break;
+			case NegamaxDriver::MTDF:
+				value = MTDF(depth, finishedStep, isFirstStep, lastBoard, currentBoard, getThisByOpponentPass, value, bestAction);
+				break;
+			}
+		}
+		return std::make_pair(bestAction, value);
+	}
+
+	virtual Action Act(const Step finishedStep, const Board lastBoard, const Board currentBoard) override {
+		auto result = Search(finishedStep, lastBoard, currentBoard);
+		return result.first;
+	}
+};
+
+class StoneCountNegamaxAgent : public NegamaxAgent<StoneCountNegamaxEvaluation> {
+private:
+	array<Step, TOTAL_POSITIONS> depthLimits;//index by num stones
+public:
+	StoneCountNegamaxAgent(const Step _depthLimit, const NegamaxDriver _driver = NegamaxDriver::MTDF, const ActionSequence& _actionSequence = DEFAULT_ACTION_SEQUENCE) : NegamaxAgent<StoneCountNegamaxEvaluation>(_depthLimit, _driver, _actionSequence) {
+		depthLimits.fill(_depthLimit);
+	}
+
+	StoneCountNegamaxAgent(const array<Step, TOTAL_POSITIONS>& _depthLimits, const NegamaxDriver _driver = NegamaxDriver::MTDF, const ActionSequence& _actionSequence = DEFAULT_ACTION_SEQUENCE) : NegamaxAgent<StoneCountNegamaxEvaluation>(0, _driver, _actionSequence), depthLimits(_depthLimits) {}
+
+	virtual Action Act(const Step finishedStep, const Board lastBoard, const Board currentBoard) override {
+		const auto numStone = Score::Stones(currentBoard);
+		const auto stones = numStone.Black + numStone.White;
+		DepthLimit = depthLimits[stones];
+#ifdef INTERACT_MODE
+		cout << "Negamax search depth: " << static_cast<int>(DepthLimit) << endl;
+#endif
+		return NegamaxAgent<StoneCountNegamaxEvaluation>::Act(finishedStep, lastBoard, currentBoard);
+	}
+};
+
+//WinEval is binary, a single null window proves the result
+typedef NegamaxAgent<WinNegamaxEvaluation> WinNegamaxAgent;
@@ -0,0 +1,263 @@
+//Name: Zongjian Li, USC ID: 6503378943
+#pragma once
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "go.h"
+
+//NUMA nodes of the machine through the system calls, no library is needed, a machine without NUMA is one node
+class Numa {
+private:
+	class Counters {
+	public:
+		atomic<UINT64> Local{ 0 };
+		atomic<UINT64> Remote{ 0 };
+		atomic<UINT64> Unpinned{ 0 };
+	};
+
+	static std::mutex& RegistryMutex() {
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	static vector<std::unique_ptr<Counters>>& Registry() {//counters of all threads ever counted, kept after they exit
+		static vector<std::unique_ptr<Counters>> registry;
+		return registry;
+	}
+
+	static Counters& ThreadCounters() {
+		thread_local Counters* counters = nullptr;
+		if (counters == nullptr) {
+			std::lock_guard<std::mutex> l(RegistryMutex());
+			Registry().push_back(std::unique_ptr<Counters>(new Counters()));
+			counters = Registry().back().get();
+		}
+		return *counters;
+	}
+
+	inline static void Increase(atomic<UINT64>& counter) {//only the owner thread writes
+		counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+#ifndef _WIN32
+	const static int MPOL_PREFERRED_POLICY = 1;
+
+	static vector<vector<int>> ReadCpus() {//from lists like 0-3,8-11
+		vector<vector<int>> result;
+		for (auto node = 0; ; node++) {
+			ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+			if (!file.is_open()) {
+				break;
+			}
+			vector<int> cpus;
+			string range;
+			while (std::getline(file, range, ',')) {
+				const auto dash = range.find('-');
+				const auto first = std::stoi(range.substr(0, dash));
+				const auto last = dash == string::npos ? first : std::stoi(range.substr(dash + 1));
+				for (auto cpu = first; cpu <= last; cpu++) {
+					cpus.push_back(cpu);
+				}
+			}
+			result.push_back(cpus);
+		}
+		return result;
+	}
+
+	static const vector<vector<int>>& Cpus() {
+		static const auto cpus = ReadCpus();
+		return cpus;
+	}
+#endif
+public:
+	static int NodeCount() {
+#ifdef _WIN32
+		ULONG highest = 0;
+		return GetNumaHighestNodeNumber(&highest) ? static_cast<int>(highest) + 1 : 1;
+#else
+		return std::max(1, static_cast<int>(Cpus().size()));
+#endif
+	}
+
+	//-1 if the thread is not pinned
+	static int& CurrentNode() {
+		thread_local int node = -1;
+		return node;
+	}
+
+	//the calling thread runs on the processors of the node only, return false if the system refuses
+	static bool Pin(const int node) {
+		auto pinned = false;
+#ifdef _WIN32
+		GROUP_AFFINITY affinity;
+		pinned = GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &affinity) && SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr);
+#else
+		if (node < static_cast<int>(Cpus().size())) {
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			for (const auto cpu : Cpus()[node]) {
+				CPU_SET(cpu, &set);
+			}
+			pinned = pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+		}
+#endif
+		CurrentNode() = pinned ? node : -1;
+		return pinned;
+	}
+
+	//pages are placed on the node, or anywhere if the system refuses
+	static void* Allocate(const size_t bytes, const int node) {
+#ifdef _WIN32
+		auto result = VirtualAllocExNuma(GetCurrentProcess(), nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, static_cast<DWORD>(node));
+		if (result == nullptr) {
+			result = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+		}
+		assert(result != nullptr);
+		return result;
+#else
+		auto result = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		assert(result != MAP_FAILED);
+		if (0 <= node && node < 64) {
+			const unsigned long mask = 1ul << node;
+			syscall(SYS_mbind, result, bytes, MPOL_PREFERRED_POLICY, &mask, sizeof(mask) * 8, 0);
+		}
+		return result;
+#endif
+	}
+
+	static void Free(void* memory, const size_t bytes) {
+#ifdef _WIN32
+		VirtualFree(memory, 0, MEM_RELEASE);
+#else
+		munmap(memory, bytes);
+#endif
+	}
+
+	//an access of the calling thread to a shard on the owner node
+	inline static void Count(const int owner) {
+		auto& counters = ThreadCounters();
+		const auto node = CurrentNode();
+		Increase(node < 0 ? counters.Unpinned : node == owner ? counters.Local : counters.Remote);
+	}
+
+	//local, remote, and by threads not pinned
+	static tuple<UINT64, UINT64, UINT64> Accesses() {
+		std::lock_guard<std::mutex> l(RegistryMutex());
+		UINT64 local = 0, remote = 0, unpinned = 0;
+		for (const auto& counters : Registry()) {
+			local += counters->Local;
+			remote += counters->Remote;
+			unpinned += counters->Unpinned;
+		}
+		return std::make_tuple(local, remote, unpinned);
+	}
+};
+
+//memory of one node handed out by bumping a pointer, nothing is freed before the whole arena
+class NodeArena {
+private:
+	const static size_t CHUNK_BYTES = 64 << 20;
+	const static size_t ALIGNMENT = 16;
+
+	class Chunk {
+	public:
+		char* Begin;
+		size_t Capacity;
+		atomic<size_t> Used{ 0 };
+	};
+
+	const int node;
+	std::mutex mutex;
+	vector<std::unique_ptr<Chunk>> chunks;
+	atomic<Chunk*> current{ nullptr };
+	atomic<UINT64> reserved{ 0 };
+
+	void Grow(Chunk* full, const size_t bytes) {
+		std::lock_guard<std::mutex> l(mutex);
+		if (current != full) {//grown by another thread
+			return;
+		}
+		auto chunk = std::unique_ptr<Chunk>(new Chunk());
+		chunk->Capacity = bytes > CHUNK_BYTES ? bytes : CHUNK_BYTES;
+		chunk->Begin = static_cast<char*>(Numa::Allocate(chunk->Capacity, node));
+		reserved += chunk->Capacity;
+		current = chunk.get();
+		chunks.push_back(std::move(chunk));
+	}
+public:
+	NodeArena(const int _node) : node(_node) {}
+
+	~NodeArena() {
+		Reset();
+	}
+
+	void* Allocate(size_t bytes) {
+		bytes = (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+		while (true) {
+			const auto chunk = current.load();
+			if (chunk != nullptr) {
+				const auto offset = chunk->Used.fetch_add(bytes);
+				if (offset + bytes <= chunk->Capacity) {
+					return chunk->Begin + offset;
+				}
+			}
+			Grow(chunk, bytes);
+		}
+	}
+
+	//only when nothing allocated is used anymore
+	void Reset() {
+		std::lock_guard<std::mutex> l(mutex);
+		for (const auto& chunk : chunks) {
+			Numa::Free(chunk->Begin, chunk->Capacity);
+		}
+		chunks.clear();
+		current = nullptr;
+		reserved = 0;
+	}
+
+	UINT64 Reserved() const {
+		return reserved;
+	}
+};
+
+//containers allocate from an arena, freeing is left to the arena
+template <typename T>
+class NodeAllocator {
+public:
+	typedef T value_type;
+
+	NodeArena* Arena;
+
+	NodeAllocator(NodeArena* arena) : Arena(arena) {}
+
+	template <typename U>
+	NodeAllocator(const NodeAllocator<U>& other) : Arena(other.Arena) {}
+
+	T* allocate(const size_t n) {
+		return static_cast<T*>(Arena->Allocate(n * sizeof(T)));
+	}
+
+	void deallocate(T*, const size_t) {}
+
+	template <typename U>
+	bool operator == (const NodeAllocator<U>& other) const {
+		return Arena == other.Arena;
+	}
+
+	template <typename U>
+	bool operator != (const NodeAllocator<U>& other) const {
+		return Arena != other.Arena;
+	}
+};
@@ -0,0 +1,109 @@
+//Name: Zongjian Li, USC ID: 6503378943
+#pragma once
+
+#include "storage.h"
+#include "numa.h"
+
+//one shard per NUMA node, a key is owned by the node chosen by its hash, shards are allocated on their nodes
+//threads pinned to a node find about 1 of node count keys locally, accesses are counted by Numa
+template <typename E>
+class NumaRecordStorage : public RecordStorage<E> {
+private:
+	typedef NodeAllocator<std::pair<const Board, E>> Allocator;
+	typedef tbb::concurrent_map<Board, E, std::less<Board>, Allocator> Shard;
+
+	vector<std::unique_ptr<NodeArena>> arenas;
+	vector<std::unique_ptr<Shard>> shards;//declared after the arenas, so destroyed before them
+
+	//another multiplier than DistributedStore::Owner, so the keys of one process still spread over all nodes
+	inline int Owner(const Board standardBoard) const {
+		return static_cast<int>((((standardBoard * 0xC2B2AE3D27D4EB4Full) >> 32) * shards.size()) >> 32);
+	}
+
+	void Recreate() {//the skip lists never free nodes by themselves, so their arenas are reset
+		for (size_t i = 0; i < shards.size(); i++) {
+			shards[i] = nullptr;
+			arenas[i]->Reset();
+			shards[i] = std::unique_ptr<Shard>(new Shard(Allocator(arenas[i].get())));
+		}
+	}
+protected:
+	void safe_insert(const Board& standardBoard, const E& record) override {
+		const auto owner = Owner(standardBoard);
+		Numa::Count(owner);
+		shards[owner]->emplace(standardBoard, record);
+	}
+
+	bool safe_lookup(const Board standardBoard, E& record) const override {
+		const auto owner = Owner(standardBoard);
+		Numa::Count(owner);
+		const auto& shard = *shards[owner];
+		auto find = shard.find(standardBoard);
+		if (find == shard.end()) {
+			return false;
+		}
+		record = find->second;
+		return true;
+	}
+
+	//shards are merged by key, so the file is sorted as the one of MemoryRecordStorage
+	void serialize(ofstream& file) override {
+		this->write_size(file, size());
+		typedef typename Shard::const_iterator Iterator;
+		vector<pair<Iterator, Iterator>> ranges;
+		for (const auto& shard : shards) {
+			ranges.emplace_back(shard->cbegin(), shard->cend());
+		}
+		while (true) {
+			auto min = ranges.end();
+			for (auto it = ranges.begin(); it != ranges.end(); it++) {
+				if (it->first != it->second && (min == ranges.end() || it->first->first < min->first->first)) {
+					min = it;
+				}
+			}
+			if (min == ranges.end()) {
+				break;
+			}
+			this->write_record(file, min->first->first, min->first->second);
+			++min->first;
+		}
+	}
+
+	void deserialize(ifstream& file) override {
+		Recreate();
+		auto size = this->read_size(file);
+		for (auto i = 0ULL; i < size; i++) {
+			auto elem = this->read_record(file);
+			shards[Owner(elem.first)]->emplace(elem.first, elem.second);
+		}
+	}
+public:
+	NumaRecordStorage() {
+		for (auto node = 0; node < Numa::NodeCount(); node++) {
+			arenas.push_back(std::unique_ptr<NodeArena>(new NodeArena(node)));
+			shards.push_back(nullptr);
+		}
+		Recreate();
+	}
+
+	RecordStorageType Type() const override {
+		return RecordStorageType::Memory;
+	}
+
+	size_t size() const override {
+		size_t result = 0;
+		for (const auto& shard : shards) {
+			result += shard->size();
+		}
+		return result;
+	}
+
+	size_t EntryBytes() const override {//skip list node of 2 levels on average, no allocator header
+		return 2 * sizeof(void*) + sizeof(pair<Board, E>);
+	}
+
+	void clear() override {
+		std::unique_lock<recursive_mutex> l(this->lock);
+		Recreate();
+	}
+};
@@ -0,0 +1,309 @@
+//Name: Zongjian Li, USC ID: 6503378943
+#pragma once
+
+#include "storage.h"
+
+//records which fit in the bits above a key
+template <typename E>
+class PackedRecord;
+
+template <>
+class PackedRecord<WinEval> {
+public:
+	const static int BITS = 2;
+
+	inline static UINT64 Pack(const WinEval& record) {
+		return (record.Initialized() ? 1ull : 0ull) | (record.Win() ? 2ull : 0ull);
+	}
+
+	inline static WinEval Unpack(const UINT64 bits) {
+		return WinEval((bits & 1) != 0, (bits & 2) != 0);
+	}
+};
+
+//open addressing with linear probing, a slot is one word of the key, a used flag and the packed record, 0 if empty
+//a slot is set once by CAS and never changed, so lookups and inserts take no lock and a record costs a little more than 8 bytes
+//growing drains the operations on this store for a moment, the threads arriving meanwhile move the slots to the new table together
+template <typename E>
+class PackedRecordStorage : public RecordStorage<E> {
+private:
+	typedef PackedRecord<E> Packer;
+
+	const static UINT64 KEY_MASK = (KEY_PASS << 1) - 1;//standard PositionKey keys
+	const static int USED_SHIFT = EMPTY_SHIFT + 1;
+	const static int RECORD_SHIFT = USED_SHIFT + 1;
+	const static size_t INITIAL_CAPACITY = 1 << 16;
+	const static size_t MIGRATION_CHUNK = 1 << 14;
+	const static size_t STRIPE_NUM = 64;
+	static_assert(RECORD_SHIFT + Packer::BITS <= 64, "record does not fit in a slot");
+
+	enum class Placed {
+		New,
+		Existing,
+		Full,
+	};
+
+	class Table {
+	public:
+		const size_t Capacity;
+		std::unique_ptr<atomic<UINT64>[]> Slots;
+
+		Table(const size_t capacity) : Capacity(capacity), Slots(new atomic<UINT64>[capacity]()) {}
+	};
+
+	class Stripe {//threads inside an operation, one cache line each
+	public:
+		atomic<int> Active{ 0 };
+		char Padding[64 - sizeof(atomic<int>)];
+	};
+
+	atomic<Table*> table;
+	atomic<size_t> capacity;
+	atomic<size_t> count{ 0 };
+	mutable array<Stripe, STRIPE_NUM> stripes;
+	mutable atomic<bool> exclusive{ false };
+	mutable atomic<int> helpers{ 0 };
+	mutable atomic<Table*> migrationSource{ nullptr };
+	mutable atomic<Table*> migrationTarget{ nullptr };
+	mutable atomic<size_t> migrationCursor{ 0 };
+	mutable atomic<size_t> migrationDone{ 0 };
+
+	inline static size_t Home(const Board key, const size_t capacity) {//multiplied into the range, so the capacity needs not be a power of 2
+		return static_cast<size_t>((((key * 0x9E3779B97F4A7C15ull) >> 32) * capacity) >> 32);
+	}
+
+	inline static UINT64 Pack(const Board key, const E& record) {
+		assert((key & ~KEY_MASK) == 0);
+		return key | (1ull << USED_SHIFT) | (Packer::Pack(record) << RECORD_SHIFT);
+	}
+
+	static Placed Place(Table& t, const UINT64 word) {
+		const auto key = word & KEY_MASK;
+		auto i = Home(key, t.Capacity);
+		for (size_t probe = 0; probe < t.Capacity; probe++) {
+			auto& slot = t.Slots[i];
+			auto current = slot.load(std::memory_order_acquire);
+			if (current == 0 && slot.compare_exchange_strong(current, word)) {
+				return Placed::New;
+			}
+			if ((current & KEY_MASK) == key) {//a failed CAS loaded the winner
+				return Placed::Existing;
+			}
+			i = i + 1 == t.Capacity ? 0 : i + 1;
+		}
+		return Placed::Full;
+	}
+
+	static UINT64 Find(const Table& t, const Board key) {
+		auto i = Home(key, t.Capacity);
+		for (size_t probe = 0; probe < t.Capacity; probe++) {
+			const auto current = t.Slots[i].load(std::memory_order_acquire);
+			if (current == 0) {
+				return 0;
+			}
+			if ((current & KEY_MASK) == key) {
+				return current;
+			}
+			i = i + 1 == t.Capacity ? 0 : i + 1;
+		}
+		return 0;
+	}
+
+	inline static size_t StripeIndex() {
+		thread_local const auto index = std::hash<std::thread::id>()(std::this_thread::get_id()) % STRIPE_NUM;
+		return index;
+	}
+
+	Stripe& Enter() const {
+		auto& stripe = stripes[StripeIndex()];
+		while (true) {
+			if (!exclusive) {
+				stripe.Active++;
+				if (!exclusive) {
+					return stripe;
+				}
+				stripe.Active--;
+			}
+			Help();
+		}
+	}
+
+	inline static void Leave(Stripe& stripe) {
+		stripe.Active--;
+	}
+
+	void Migrate(const Table& source, Table& target) const {
+		while (true) {
+			const auto begin = migrationCursor.fetch_add(MIGRATION_CHUNK);
+			if (begin >= source.Capacity) {
+				return;
+			}
+			const auto end = std::min(source.Capacity, begin + MIGRATION_CHUNK);
+			for (auto i = begin; i < end; i++) {
+				const auto word = source.Slots[i].load(std::memory_order_relaxed);
+				if (word != 0) {
+					Place(target, word);
+				}
+			}
+			migrationDone += end - begin;
+		}
+	}
+
+	//wait until the exclusive section is over, moving slots if a migration is running
+	void Help() const {
+		while (exclusive) {
+			helpers++;
+			const auto target = migrationTarget.load();
+			if (target != nullptr) {
+				Migrate(*migrationSource.load(), *target);
+			}
+			helpers--;
+			std::this_thread::yield();
+		}
+	}
+
+	bool Lock() const {
+		auto expected = false;
+		if (!exclusive.compare_exchange_strong(expected, true)) {
+			return false;
+		}
+		for (auto& stripe : stripes) {
+			while (stripe.Active != 0) {
+				std::this_thread::yield();
+			}
+		}
+		return true;
+	}
+
+	void Unlock() const {
+		exclusive = false;
+	}
+
+	//by a thread not inside an operation, nothing is done if the table is already replaced
+	void Grow(const size_t fullCapacity) {
+		if (!Lock()) {
+			Help();
+			return;
+		}
+		const auto full = table.load();
+		if (full->Capacity != fullCapacity) {
+			Unlock();
+			return;
+		}
+		assert(fullCapacity < (1ull << 32) / 3 * 2);
+		auto target = new Table(fullCapacity / 2 * 3);
+		migrationCursor = 0;
+		migrationDone = 0;
+		migrationSource = full;
+		migrationTarget = target;
+		Migrate(*full, *target);
+		while (migrationDone < full->Capacity) {
+			std::this_thread::yield();
+		}
+		migrationTarget = nullptr;
+		while (helpers != 0) {//a helper may still read the source
+			std::this_thread::yield();
+		}
+		migrationSource = nullptr;
+		table = target;
+		capacity = target->Capacity;
+		delete full;
+		Unlock();
+	}
+
+	void Reset(const size_t newCapacity) {
+		while (!Lock()) {
+			Help();
+		}
+		delete table.exchange(new Table(newCapacity));
+		capacity = newCapacity;
+		count = 0;
+		Unlock();
+	}
+protected:
+	void safe_insert(const Board& standardBoard, const E& record) override {
+		const auto word = Pack(standardBoard, record);
+		while (true) {
+			auto& stripe = Enter();
+			const auto current = table.load();
+			const auto slots = current->Capacity;//the table may be replaced after leaving
+			const auto placed = Place(*current, word);
+			Leave(stripe);
+			if (placed == Placed::Existing) {
+				return;
+			} else if (placed == Placed::New) {
+				if (++count * 5 > slots * 4) {//load factor 0.8
+					Grow(slots);
+				}
+				return;
+			}
+			Grow(slots);
+		}
+	}
+
+	bool safe_lookup(const Board standardBoard, E& record) const override {
+		auto& stripe = Enter();
+		const auto word = Find(*table.load(), standardBoard);
+		Leave(stripe);
+		if (word == 0) {
+			return false;
+		}
+		record = Packer::Unpack(word >> RECORD_SHIFT);
+		return true;
+	}
+
+	//slots are copied out and sorted, so the file is the one of MemoryRecordStorage
+	void serialize(ofstream& file) override {
+		vector<UINT64> words;
+		words.reserve(count);
+		auto& stripe = Enter();
+		const auto& t = *table.load();
+		for (size_t i = 0; i < t.Capacity; i++) {
+			const auto word = t.Slots[i].load(std::memory_order_relaxed);
+			if (word != 0) {
+				words.push_back(word);
+			}
+		}
+		Leave(stripe);
+		std::sort(words.begin(), words.end(), [](const UINT64 a, const UINT64 b) {
+			return (a & KEY_MASK) < (b & KEY_MASK);
+		});
+		this->write_size(file, words.size());
+		for (const auto word : words) {
+			this->write_record(file, word & KEY_MASK, Packer::Unpack(word >> RECORD_SHIFT));
+		}
+	}
+
+	void deserialize(ifstream& file) override {
+		auto size = this->read_size(file);
+		Reset(size / 4 * 5 + INITIAL_CAPACITY);
+		for (auto i = 0ULL; i < size; i++) {
+			auto elem = this->read_record(file);
+			safe_insert(elem.first, elem.second);
+		}
+	}
+public:
+	PackedRecordStorage() : table(new Table(INITIAL_CAPACITY)), capacity(INITIAL_CAPACITY) {}
+
+	~PackedRecordStorage() {
+		delete table.load();
+	}
+
+	RecordStorageType Type() const override {
+		return RecordStorageType::Memory;
+	}
+
+	size_t size() const override {
+		return count;
+	}
+
+	size_t EntryBytes() const override {//the empty slots are shared by the records
+		const auto s = size();
+		return s == 0 ? sizeof(UINT64) : sizeof(UINT64) * capacity / s;
+	}
+
+	void clear() override {
+		std::unique_lock<recursive_mutex> l(this->lock);
+		Reset(INITIAL_CAPACITY);
+	}
+};
@@ -0,0 +1,82 @@
+//Name: Zongjian Li, USC ID: 6503378943
+#pragma once
+
+#include "go.h"
+
+class XorShift {
+private:
+	UINT64 state;
+public:
+	XorShift(const UINT64 seed) : state(seed == 0 ? 0x9E3779B97F4A7C15ull : seed) {}
+
+	inline UINT64 Next() {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
+
+	//uniform in [0, bound)
+	inline UINT32 Below(const UINT32 bound) {
+		return static_cast<UINT32>(((Next() >> 32) * bound) >> 32);
+	}
+};
+
+//random games on position sets only, no action lists, no allocation
+//players never fill their own eyes and pass when no other move is legal
+class PlayoutKernel {
+private:
+	XorShift rng;
+
+	inline Board Pick(const Board candidates) {
+		auto rest = candidates;
+		for (auto skip = rng.Below(__builtin_popcountll(candidates)); skip > 0; skip--) {
+			rest &= rest - 1;
+		}
+		return rest & (~rest + 1);
+	}
+public:
+	UINT64 Moves = 0;
+
+	PlayoutKernel(const UINT64 seed) : rng(seed) {}
+
+	//play until MAX_STEP or two consecutive passes, return winner
+	Player Run(Step finishedStep, const Board lastBoard, const Board currentBoard, bool getThisByOpponentPass) {
+		array<Board, 2> stones = { BitBoardUtil::Stones(currentBoard, Player::Black), BitBoardUtil::Stones(currentBoard, Player::White) };
+		array<Board, 2> last = { BitBoardUtil::Stones(lastBoard, Player::Black), BitBoardUtil::Stones(lastBoard, Player::White) };
+		while (finishedStep < MAX_STEP) {
+			const auto player = static_cast<int>(TurnUtil::WhoNext(finishedStep));
+			const auto opponent = 1 - player;
+			const auto isFirstStep = finishedStep == INITIAL_FINISHED_STEP;
+			const auto empty = ~(stones[0] | stones[1]) & BIT_FULL;
+			auto candidates = empty & ~BitBoardUtil::Eyes(stones[player], empty);
+			auto moved = false;
+			auto own = stones[player];
+			auto other = stones[opponent];
+			while (candidates != 0) {
+				const auto position = Pick(candidates);
+				candidates &= ~position;
+				own = stones[player];
+				other = stones[opponent];
+				if (BitBoardUtil::Place(own, other, position) && (isFirstStep || own != last[player] || other != last[opponent])) {//no suicide, no ko
+					moved = true;
+					break;
+				}
+			}
+			last = stones;
+			finishedStep++;
+			if (!moved) {
+				if (getThisByOpponentPass) {
+					break;
+				}
+				getThisByOpponentPass = true;
+				continue;
+			}
+			Moves++;
+			stones[player] = own;
+			stones[opponent] = other;
+			getThisByOpponentPass = false;
+		}
+		return Score::Winner(BitBoardUtil::Compose(stones[0], stones[1])).first;
+	}
+};
@@ -0,0 +1,81 @@
+//Name: Zongjian Li, USC ID: 6503378943
+
+#include <iomanip>
+
+#include "go.h"
+#include "agent.h"
+#include "game_host.h"
+#include "playout.h"
+
+//usage: playout_benchmark [seconds of each run] [max thread number]
+
+using std::chrono::high_resolution_clock;
+using std::chrono::duration;
+
+double HostRate(const double seconds) {
+	RandomAgent black, white;
+	UINT64 games = 0;
+	const auto start = high_resolution_clock::now();
+	auto elapsed = 0.0;
+	while (elapsed < seconds) {
+		Host host(black, white);
+		host.RunToEnd();
+		games++;
+		elapsed = duration<double>(high_resolution_clock::now() - start).count();
+	}
+	return games / elapsed;
+}
+
+double KernelRate(const double seconds, const int threadNum) {
+	vector<UINT64> counts(threadNum, 0);
+	vector<UINT64> wins(threadNum, 0);//keeps the playouts from being optimized away
+	atomic<bool> stop;
+	stop.store(false);
+	vector<std::unique_ptr<thread>> threads;
+	const auto start = high_resolution_clock::now();
+	for (auto i = 0; i < threadNum; i++) {
+		threads.push_back(std::unique_ptr<thread>(new thread([&counts, &wins, &stop, i]() {
+			PlayoutKernel kernel(0x2545F4914F6CDD1Dull * (i + 1));
+			UINT64 count = 0;
+			UINT64 blackWins = 0;
+			while (!stop.load(std::memory_order_relaxed)) {
+				blackWins += kernel.Run(INITIAL_FINISHED_STEP, EMPTY_BOARD, EMPTY_BOARD, false) == Player::Black;
+				count++;
+			}
+			counts[i] = count;
+			wins[i] = blackWins;
+		})));
+	}
+	std::this_thread::sleep_for(duration<double>(seconds));
+	stop.store(true);
+	for (auto& t : threads) {
+		t->join();
+	}
+	const auto elapsed = duration<double>(high_resolution_clock::now() - start).count();
+	UINT64 total = 0;
+	for (const auto c : counts) {
+		total += c;
+	}
+	return total / elapsed;
+}
+
+int main(int argc, char* argv[]) {
+	const auto seconds = argc > 1 ? std::atof(argv[1]) : 2.0;
+	const auto maxThread = argc > 2 ? std::atoi(argv[2]) : std::max(1, static_cast<int>(thread::hardware_concurrency()));
+	cout << std::fixed << std::setprecision(0);
+	cout << "host + random agent, 1 thread: " << HostRate(seconds) << " playouts/s" << endl;
+	vector<int> threadNums;
+	for (auto n = 1; n < maxThread; n *= 2) {
+		threadNums.push_back(n);
+	}
+	threadNums.push_back(maxThread);
+	auto single = 0.0;
+	for (const auto threadNum : threadNums) {
+		const auto rate = KernelRate(seconds, threadNum);
+		if (threadNum == 1) {
+			single = rate;
+		}
+		cout << "kernel, " << threadNum << " threads: " << rate << " playouts/s, " << rate / threadNum << " per thread, scaling " << std::setprecision(2) << rate / single << std::setprecision(0) << endl;
+	}
+	return 0;
+}
@@ -0,0 +1,231 @@
+//Name: Zongjian Li, USC ID: 6503378943
+#pragma once
+
+#include "go.h"
+#include "eval.h"
+
+//layered retrograde solver: positions reachable from a root are enumerated forward one finished step at a time,
+//then each layer is solved exactly once, from the last step back to the root, against the solved layer after it
+//positions are standard PositionKey keys, so ko and passing positions are exact and every one of them is stored
+class RetrogradeSolver {
+public:
+	using E = WinEval;
+	using Layer = vector<pair<Board, E>>;//sorted by key, evaluations are from the view of the player to move
+private:
+	const string prefix;
+	const int threadNum;
+
+	string SolvedFilename(const Step finishedStep) const {//same as StorageManager, so solved layers can be deserialized
+		return prefix + std::to_string(finishedStep);
+	}
+
+	static bool Less(const pair<Board, E>& a, const pair<Board, E>& b) {
+		return a.first < b.first;
+	}
+
+	inline static Action KoAction(const Board key) {
+		const auto koField = Field::StepField(key);
+		return koField == 0 ? Action::Pass : static_cast<Action>(1ull << ((koField >> KEY_KO_SHIFT) - 1));
+	}
+
+	static void Write(const string& filename, const Layer& layer) {
+		ofstream file(filename, std::ios::binary);
+		assert(file.is_open());
+		UINT64 size = layer.size();
+		file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+		for (const auto& item : layer) {
+			file.write(reinterpret_cast<const char*>(&item.first), sizeof(item.first));
+			file.write(reinterpret_cast<const char*>(&item.second), sizeof(item.second));
+		}
+		file.close();
+	}
+
+	static bool Read(const string& filename, Layer& layer) {
+		layer.clear();
+		ifstream file(filename, std::ios::binary);
+		if (!file.is_open()) {
+			return false;
+		}
+		UINT64 size;
+		file.read(reinterpret_cast<char*>(&size), sizeof(size));
+		layer.resize(size);
+		for (auto& item : layer) {
+			file.read(reinterpret_cast<char*>(&item.first), sizeof(item.first));
+			file.read(reinterpret_cast<char*>(&item.second), sizeof(item.second));
+		}
+		file.close();
+		return true;
+	}
+
+	static bool Find(const Layer& layer, const Board key, E& evaluation) {
+		const auto iter = std::lower_bound(layer.begin(), layer.end(), std::make_pair(key, E()), Less);
+		if (iter == layer.end() || iter->first != key) {
+			return false;
+		}
+		evaluation = iter->second;
+		return true;
+	}
+public:
+	vector<pair<Step, UINT64>> Census;//enumerated layer sizes
+
+	RetrogradeSolver(const string& _prefix, const int _threadNum) : prefix(_prefix), threadNum(_threadNum) {}
+
+	//non-terminal children of a layer, sorted and unique
+	Layer Expand(const Step finishedStep, const Layer& layer) const {
+		vector<vector<Board>> parts(std::max(1, threadNum));
+		Parallel(threadNum, layer.size(), [&](const size_t begin, const size_t end, const size_t index) {
+			auto& part = parts[index];
+			for (auto i = begin; i < end; i++) {
+				ForEachChild(finishedStep, layer[i].first, [&](const Board key, const bool terminal, const E&) {
+					if (!terminal) {
+						part.push_back(key);
+					}
+				});
+			}
+			std::sort(part.begin(), part.end());
+			part.erase(std::unique(part.begin(), part.end()), part.end());
+		});
+		vector<Board> keys;
+		for (auto& part : parts) {
+			keys.insert(keys.end(), part.begin(), part.end());
+			vector<Board>().swap(part);
+		}
+		std::sort(keys.begin(), keys.end());
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+		Layer result;
+		result.reserve(keys.size());
+		for (const auto key : keys) {
+			result.emplace_back(key, E());
+		}
+		return result;
+	}
+
+	static string LayerFilename(const string& prefix, const Step finishedStep) {
+		return prefix + "layer_" + std::to_string(finishedStep);
+	}
+
+	static Board RootKey(const Step rootFinishedStep, const Board lastBoard, const Board currentBoard) {
+		const auto isFirstStep = rootFinishedStep == INITIAL_FINISHED_STEP;
+		bool ko;
+		Action koAction;
+		LegalActionIterator::ListAll(TurnUtil::WhoNext(rootFinishedStep), lastBoard, currentBoard, isFirstStep, &DEFAULT_ACTION_SEQUENCE, ko, koAction);
+		return PositionKey::Standard(PositionKey::Make(currentBoard, koAction, !isFirstStep && lastBoard == currentBoard));
+	}
+
+	//visit(key, terminal, evaluation), a terminal child is evaluated for the player to move in this position
+	template <typename F>
+	static void ForEachChild(const Step finishedStep, const Board key, F visit) {
+		ForEachMove(finishedStep, key, [&](const Action, const Board childKey, const bool terminal, const E& evaluation) {
+			visit(childKey, terminal, evaluation);
+		});
+	}
+
+	//visit(action, key, terminal, evaluation), actions are on the board of the key
+	template <typename F>
+	static void ForEachMove(const Step finishedStep, const Board key, F visit) {
+		const auto board = Field::BoardField(key);
+		const auto koAction = KoAction(key);
+		const auto passed = (key & KEY_PASS) != 0;
+		const auto player = TurnUtil::WhoNext(finishedStep);
+		const Step nextFinishedStep = finishedStep + 1;
+		for (const auto& a : LegalActionIterator::ListAll(player, EMPTY_BOARD, board, true, &DEFAULT_ACTION_SEQUENCE)) {//ko is in the key
+			if (koAction != Action::Pass && a.first == koAction) {
+				continue;
+			}
+			const auto pass = a.first == Action::Pass;
+			if ((passed && pass) || nextFinishedStep == MAX_STEP) {
+				visit(a.first, a.second, true, E(player, a.second));
+				continue;
+			}
+			bool ko;
+			auto childKo = Action::Pass;
+			if (!pass) {
+				LegalActionIterator::ListAll(TurnUtil::Opponent(player), board, a.second, false, &DEFAULT_ACTION_SEQUENCE, ko, childKo);
+			}
+			visit(a.first, PositionKey::Standard(PositionKey::Make(a.second, childKo, pass)), false, E());
+		}
+	}
+
+	template <typename F>
+	static void Parallel(const int threadNum, const size_t size, F func) {//func(begin, end, thread index)
+		const auto num = static_cast<size_t>(std::max(1, threadNum));
+		const auto chunk = (size + num - 1) / num;
+		vector<std::unique_ptr<thread>> threads;
+		for (size_t i = 1; i < num && i * chunk < size; i++) {
+			threads.push_back(std::unique_ptr<thread>(new thread(func, i * chunk, std::min(size, (i + 1) * chunk), i)));
+		}
+		func(0, std::min(size, chunk), 0);
+		for (auto& t : threads) {
+			t->join();
+		}
+	}
+
+	//forward pass, layers from the root step to the last non-terminal step are written to layer files
+	void Enumerate(const Step rootFinishedStep, const Board lastBoard, const Board currentBoard) {
+		assert(rootFinishedStep < MAX_STEP);
+		Layer layer = { std::make_pair(RootKey(rootFinishedStep, lastBoard, currentBoard), E()) };
+		Census.clear();
+		for (auto step = rootFinishedStep; ; step++) {
+			Write(LayerFilename(prefix, step), layer);
+			Census.emplace_back(step, layer.size());
+			cout << "Enumerated step " << int(step) << ": " << layer.size() << " positions" << endl;
+			if (step + 1 >= MAX_STEP) {
+				break;
+			}
+			layer = Expand(step, layer);
+		}
+	}
+
+	//backward pass, needs the layer files of all steps from the root step on, return false if one is missing
+	//a position with a missing child is only kept if another child wins, so every written value is exact
+	bool Solve(const Step rootFinishedStep) {
+		Layer next;
+		for (Step step = MAX_STEP - 1; ; step--) {
+			Layer layer;
+			if (!Read(LayerFilename(prefix, step), layer)) {
+				cout << "Layer " << int(step) << " not found" << endl;
+				return false;
+			}
+			atomic<UINT64> missing(0);
+			Parallel(threadNum, layer.size(), [&](const size_t begin, const size_t end, const size_t) {
+				for (auto i = begin; i < end; i++) {
+					auto best = E();
+					auto incomplete = false;
+					ForEachChild(step, layer[i].first, [&](const Board key, const bool terminal, const E& evaluation) {
+						if (best.GoodEnough()) {
+							return;
+						}
+						auto value = evaluation;
+						if (!terminal) {
+							E child;
+							if (!Find(next, key, child)) {
+								missing++;
+								incomplete = true;
+								return;
+							}
+							value = child.OpponentView();
+						}
+						if (best.Compare(value) < 0) {
+							best = value;
+						}
+					});
+					layer[i].second = incomplete && !best.GoodEnough() ? E() : best;
+				}
+			});
+			const auto solved = layer.size();
+			layer.erase(std::remove_if(layer.begin(), layer.end(), [](const pair<Board, E>& item) { return !item.second.Initialized(); }), layer.end());
+			Write(SolvedFilename(step), layer);
+			cout << "Solved step " << int(step) << ": " << layer.size() << " positions" << (missing > 0 ? ", missing children " + std::to_string(missing.load()) + ", left out " + std::to_string(solved - layer.size()) : "") << endl;
+			next = std::move(layer);
+			if (step == rootFinishedStep) {
+				break;
+			}
+		}
+		return true;
+	}
+
+	bool Run(const Step rootFinishedStep, const Board lastBoard, const Board currentBoard) {
+		Enumerate(rootFinishedStep, lastBoard, currentBoard);
+		return Solve(rootFinishedStep);
+	}
+};
@@ -0,0 +1,198 @@
+//Name: Zongjian Li, USC ID: 6503378943
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <set>
+
+#include "full_search.h"
+
+//the full search is split at a finished step into canonical sub trees, each worker takes sub trees from the back of its own queue
+//and steals from the front of the others, a running worker shares its unexpanded actions when some worker is idle and nothing is queued
+//after all sub trees are solved, one worker searches the root, which mostly reads their results from the store
+class WorkScheduler {
+private:
+	class Queue {
+	public:
+		std::mutex Mutex;
+		std::deque<SearchTask> Tasks;
+	};
+
+	class Worker : public SearchTaskSink {
+	private:
+		WorkScheduler& scheduler;
+		const int id;
+	public:
+		Worker(WorkScheduler& _scheduler, const int _id) : scheduler(_scheduler), id(_id) {}
+
+		virtual bool Hungry() const override {
+			return scheduler.idle > 0 && scheduler.queued == 0;
+		}
+
+		virtual void Donate(const SearchTask& task) override {
+			if (scheduler.Add(task)) {
+				scheduler.Push(id, task, true);
+			}
+		}
+	};
+
+	vector<std::unique_ptr<Queue>> queues;
+	std::mutex seenMutex;
+	std::set<pair<Step, Board>> seen;//canonical keys of all sub trees ever queued
+	atomic<int> queued;
+	atomic<int> running;
+	atomic<int> idle;
+	atomic<bool> rootTaken;
+	atomic<bool> finished;
+	bool seeded = false;
+	SearchTask root;
+	std::function<bool(const SearchTask&)> owned;//sub trees seeded in this process, all if empty
+	std::function<bool()> rootGate;//asked when all sub trees here are solved, whether the root can be searched now, always if empty
+
+	bool Add(const SearchTask& task) {
+		std::lock_guard<std::mutex> lock(seenMutex);
+		return seen.emplace(task.FinishedStep, task.Key()).second;
+	}
+
+	void Push(const int id, const SearchTask& task, const bool front) {
+		auto& queue = *queues[id];
+		std::lock_guard<std::mutex> lock(queue.Mutex);
+		if (front) {//to be stolen first
+			queue.Tasks.push_front(task);
+		} else {
+			queue.Tasks.push_back(task);
+		}
+		queued++;
+	}
+
+	bool Take(const int id, SearchTask& task) {
+		for (size_t i = 0; i < queues.size(); i++) {
+			const auto victim = (id + i) % queues.size();
+			auto& queue = *queues[victim];
+			std::lock_guard<std::mutex> lock(queue.Mutex);
+			if (queue.Tasks.empty()) {
+				continue;
+			}
+			if (i == 0) {//own queue, the latest one
+				task = queue.Tasks.back();
+				queue.Tasks.pop_back();
+			} else {//the oldest one, which is usually the largest
+				task = queue.Tasks.front();
+				queue.Tasks.pop_front();
+			}
+			running++;
+			queued--;
+			return true;
+		}
+		return false;
+	}
+public:
+	WorkScheduler(const size_t queueNum) : queued(0), running(0), idle(0), rootTaken(false), finished(false) {
+		for (size_t i = 0; i < queueNum; i++) {
+			queues.push_back(std::unique_ptr<Queue>(new Queue()));
+		}
+	}
+
+	//only when no worker is running, set before seeding when several processes share the sub trees
+	void Partition(const std::function<bool(const SearchTask&)>& _owned, const std::function<bool()>& _rootGate) {
+		owned = _owned;
+		rootGate = _rootGate;
+	}
+
+	//only when no worker is running, sub trees are the positions at finished step splitDepth under the root, shared round robin by workerNum workers
+	void Seed(const SearchTask& _root, const Step splitDepth, const int workerNum) {
+		if (seeded && !finished) {
+			return;
+		}
+		for (auto& queue : queues) {
+			queue->Tasks.clear();
+		}
+		seen.clear();
+		queued = 0;
+		running = 0;
+		rootTaken = false;
+		finished = false;
+		root = _root;
+		vector<SearchTask> layer = { root };
+		for (Step step = root.FinishedStep; step < splitDepth && step + 1 < MAX_STEP; step++) {
+			vector<SearchTask> next;
+			for (const auto& task : layer) {
+				for (const auto& a : LegalActionIterator::ListAll(TurnUtil::WhoNext(step), task.LastBoard, task.CurrentBoard, step == INITIAL_FINISHED_STEP, &DEFAULT_ACTION_SEQUENCE)) {
+					if (a.first == Action::Pass && task.OpponentAction == Action::Pass) {//finished by 2 passings
+						continue;
+					}
+					const auto child = SearchTask(step + 1, task.CurrentBoard, a.second, a.first);
+					if (Add(child)) {
+						next.push_back(child);
+					}
+				}
+			}
+			layer = std::move(next);
+		}
+		if (!layer.empty() && layer.front().FinishedStep == root.FinishedStep) {//not split, only the root is searched
+			layer.clear();
+		}
+		const auto num = static_cast<size_t>(std::max(1, std::min(workerNum, static_cast<int>(queues.size()))));
+		size_t pushed = 0;
+		for (const auto& task : layer) {
+			if (!owned || owned(task)) {
+				Push(pushed++ % num, task, false);
+			}
+		}
+		seeded = true;
+		cout << "Split into " << layer.size() << " sub trees" << (pushed < layer.size() ? ", " + std::to_string(pushed) + " in this process" : "") << endl;
+	}
+
+	//only when no worker is running, suspended searchers of the old split must be dropped
+	void Reset() {
+		seeded = false;
+	}
+
+	//run by each worker until everything is solved or its token is set
+	//a sub tree or the root stopped by the token stays in flight in the suspended searcher, idle workers adopt suspended searchers
+	void Work(const int id, std::unique_ptr<FullSearcher>& searcher, SuspendedSearchers& suspended) {
+		Worker sink(*this, id);
+		auto waiting = false;
+		auto busy = [&]() {
+			if (waiting) {
+				idle--;
+				waiting = false;
+			}
+		};
+		auto finish = [&](const bool completed, const SearchTask& task) {
+			if (!completed) {
+				return;
+			}
+			if (task.FinishedStep != root.FinishedStep) {
+				running--;
+			} else {
+				finished = true;
+				cout << "All sub trees and the root are solved" << endl;
+			}
+		};
+		while (!searcher->Stopped() && !finished) {
+			SearchTask task;
+			if (searcher->Suspended()) {
+				busy();
+				finish(searcher->Resume(&sink), searcher->Task());
+			} else if (Take(id, task)) {
+				busy();
+				finish(searcher->Start(task, &sink), task);
+			} else if (running == 0 && queued == 0 && !rootTaken && (!rootGate || rootGate()) && !rootTaken.exchange(true)) {
+				busy();
+				finish(searcher->Start(root, &sink), root);
+			} else if (!suspended.Adopt(searcher)) {
+				if (!waiting) {
+					idle++;
+					waiting = true;
+				}
+				std::this_thread::sleep_for(milliseconds(1));
+			}
+		}
+		busy();
+	}
+
+	int Queued() const {
+		return queued;
+	}
+};
@@ -1,6 +1,13 @@
 
 #include "cache_storage.h"
+#include "numa_storage.h"
+#include "packed_storage.h"
 #include "full_search.h"
+#include "enumerator.h"
+#include "scheduler.h"
+#include "distributed.h"
+#include "best.h"
+#include "telemetry.h"
 
 const int MAX_NUM_THREAD = 112;
 
@@ -8,24 +15,51 @@ class Thread {
 private:
 	const Step& startMiniMaxFinishedStep;
 	const Step& startCutOffFinishedStep;
+	const LeafSolver& leafSolver;
+	const size_t& proofTableCapacity;
+	const Step& splitDepth;
+	const bool& extendedKeys;
+	const bool& enhancedCutOff;
+	const KeptRecords& keptRecords;
+	const Step& workSplitDepth;
+	const bool& numaPinning;
 
 	StorageManager<WinEval>& Store;
 	array<std::unique_ptr<thread>, MAX_NUM_THREAD> Threads{ nullptr };
-	int ThreadNum = 0;
+	array<std::unique_ptr<FullSearcher>, MAX_NUM_THREAD> Searchers{ nullptr };
+	array<ActionSequence, MAX_NUM_THREAD> Sequences;//kept for suspended searchers
+	array<atomic<bool>, MAX_NUM_THREAD> Tokens;
+	atomic<int> ThreadNum{ 0 };//read by telemetry
 
 	void Search(int id) {
+		if (numaPinning) {//round robin, so nodes stay balanced at any thread num
+			Numa::Pin(id % Numa::NodeCount());
+		}
 		cout << "Thread " << id + 1 << " started" << endl;
-		srand(id);
-		thread_local ActionSequence sequence = DEFAULT_ACTION_SEQUENCE;
-		std::random_shuffle(sequence.begin(), sequence.end());
-		FullSearcher searcher(Store, sequence, startMiniMaxFinishedStep, startCutOffFinishedStep, Tokens.at(id));
-		searcher.Start();
+		auto& searcher = Searchers.at(id);
+		if (workSplitDepth == 0) {
+			auto completed = searcher->Suspended() ? searcher->Resume() : searcher->Start();
+			while (completed && Suspended.Adopt(searcher)) {
+				completed = searcher->Resume();
+			}
+		} else {
+			Scheduler.Work(id, searcher, Suspended);
+		}
 		cout << "Thread " << id + 1 << " exit" << endl;
 	}
 public:
-	Thread(StorageManager<WinEval>& _store, const Step& _startMiniMaxFinishedStep, const Step& _startCutOffFinishedStep) : Store(_store), startMiniMaxFinishedStep(_startMiniMaxFinishedStep), startCutOffFinishedStep(_startCutOffFinishedStep){}
+	Thread(StorageManager<WinEval>& _store, const Step& _startMiniMaxFinishedStep, const Step& _startCutOffFinishedStep, const LeafSolver& _leafSolver, const size_t& _proofTableCapacity, const Step& _splitDepth, const bool& _extendedKeys, const bool& _enhancedCutOff, const KeptRecords& _keptRecords, const Step& _workSplitDepth, const bool& _numaPinning) : Store(_store), startMiniMaxFinishedStep(_startMiniMaxFinishedStep), startCutOffFinishedStep(_startCutOffFinishedStep), leafSolver(_leafSolver), proofTableCapacity(_proofTableCapacity), splitDepth(_splitDepth), extendedKeys(_extendedKeys), enhancedCutOff(_enhancedCutOff), keptRecords(_keptRecords), workSplitDepth(_workSplitDepth), numaPinning(_numaPinning) {
+		for (auto i = 0; i < MAX_NUM_THREAD; i++) {
+			srand(i);
+			Sequences[i] = DEFAULT_ACTION_SEQUENCE;
+			std::random_shuffle(Sequences[i].begin(), Sequences[i].end());
+			Tokens[i] = false;
+		}
+	}
 
-	array<bool, MAX_NUM_THREAD> Tokens{ false };
+	array<StatisticsSnapshot, MAX_NUM_THREAD> Snapshots;
+	WorkScheduler Scheduler{ MAX_NUM_THREAD };
+	SuspendedSearchers Suspended;//stopped in the middle of a search, resumed first when threads are added
 
 	bool Resize(const unsigned char num) {
 		if (num > MAX_NUM_THREAD) {
@@ -37,11 +71,22 @@ public:
 			}
 			for (auto i = num; i < ThreadNum; i++) {
 				Threads[i]->join();
-				Tokens[i] = false;
 				Threads[i] = nullptr;
+				if (Searchers[i]->Suspended()) {
+					Suspended.Put(std::move(Searchers[i]));
+				}
+				Searchers[i] = nullptr;
 			}
 		} else if (num > ThreadNum) {
-			for (auto i = ThreadNum; i < num; i++) {
+			if (ThreadNum == 0 && workSplitDepth > 0) {
+				Scheduler.Seed(SearchTask(), workSplitDepth, num);
+			}
+			for (int i = ThreadNum; i < num; i++) {
+				Tokens[i] = false;
+				if (!Suspended.Take(Searchers[i])) {
+					Searchers[i] = std::make_unique<FullSearcher>(Store, Sequences[i], startMiniMaxFinishedStep, startCutOffFinishedStep, leafSolver, proofTableCapacity, splitDepth, extendedKeys, enhancedCutOff, keptRecords, Tokens[i]);
+				}
+				Searchers[i]->Bind(Tokens[i], &Snapshots[i]);
 				Threads[i] = std::make_unique<thread>(&Thread::Search, this, i);
 			}
 		}
@@ -67,11 +112,26 @@ public:
 		cout << "\t" << "s: serialize" << endl;
 		cout << "\t" << "d: deserialize" << endl;
 		cout << "\t" << "t[0-24]: thread num" << endl;
-		cout << "\t" << "b[0-24][cme]: switch backend [cache|memory|external]" << endl;
+		cout << "\t" << "b[0-24][cmnp]: switch backend [cache|memory|memory sharded by NUMA node|packed lock-free hash table]" << endl;
 		cout << "\t" << "c[0-24]: clear storage" << endl;
 		cout << "\t" << "s[0-24][tf]: set serialize flag" << endl;
+		cout << "\t" << "i[seconds]: log new entries incrementally while searching, compacted from time to time, 0 to stop" << endl;
+		cout << "\t" << "j[seconds]: append a telemetry line in JSON to the telemetry file, 0 to stop" << endl;
 		cout << "\t" << "o[0-24]: cut-off start depth" << endl;
 		cout << "\t" << "m[0-24]: minimax start depth" << endl;
+		cout << "\t" << "l[ap]: leaf solver [alpha-beta|proof-number]" << endl;
+		cout << "\t" << "y[0-24]: alpha-beta parallel split depth" << endl;
+		cout << "\t" << "k[tf]: store ko and passing positions with extended keys" << endl;
+		cout << "\t" << "f[tf]: probe all children in the store before expanding any of them (enhanced transposition cut-off)" << endl;
+		cout << "\t" << "a[tf]: mark positions being searched, other threads search their siblings first" << endl;
+		cout << "\t" << "u[tf]: pin threads to NUMA nodes" << endl;
+		cout << "\t" << "w[0-24]: work split depth, sub trees are scheduled to threads, 0 for all threads from the root" << endl;
+		cout << "\t" << "n[rank]/[num]: join a distributed solve as process rank of num, needs a work split depth, positions are owned by hash" << endl;
+		cout << "\t" << "g[num]: merge partition files serialized by num processes into step files" << endl;
+		cout << "\t" << "z[abw]: store [all positions|only black wins|only white wins], one side keeps the stores to the proof tree of its win for v" << endl;
+		cout << "\t" << "v[0-24]: write the winning strategy from the root up to the given step from the stores into best action files" << endl;
+		cout << "\t" << "x: retrograde solve all steps by layers, then d to load" << endl;
+		cout << "\t" << "xe[MB]: same as x, layers are enumerated with an external sorter of given memory" << endl;
 	}
 
 	static void Illegal() {
@@ -81,6 +141,14 @@ public:
 
 Step startMiniMaxFinishedStep = MAX_STEP;
 Step startCutOffFinishedStep = 2;
+LeafSolver leafSolver = LeafSolver::AlphaBeta;
+size_t proofTableCapacity = 1 << 20;
+Step splitDepth = 0;
+bool extendedKeys = false;
+bool enhancedCutOff = true;
+KeptRecords keptRecords = KeptRecords::All;
+Step workSplitDepth = 0;
+bool numaPinning = false;
 
 int main(int argc, char* argv[]) {
 	if (argc != 2) {
@@ -88,13 +156,36 @@ int main(int argc, char* argv[]) {
 		return -1;
 	}
 	StorageManager<WinEval> record(argv[1]);
-	auto threads = std::make_shared<Thread>(record, startMiniMaxFinishedStep, startCutOffFinishedStep);
+	auto threads = std::make_shared<Thread>(record, startMiniMaxFinishedStep, startCutOffFinishedStep, leafSolver, proofTableCapacity, splitDepth, extendedKeys, enhancedCutOff, keptRecords, workSplitDepth, numaPinning);
 	auto serializeRe = std::regex("s(\\d+)([tf])");
 	auto threadRe = std::regex("t(\\d+)");
 	auto clearRe = std::regex("c(\\d+)");
-	auto backendRe = std::regex("b(\\d+)([cm])");
+	auto backendRe = std::regex("b(\\d+)([cmnp])");
 	auto minimaxRe = std::regex("m(\\d+)");
 	auto cutoffRe = std::regex("o(\\d+)");
+	auto leafRe = std::regex("l([ap])");
+	auto splitRe = std::regex("y(\\d+)");
+	auto keyRe = std::regex("k([tf])");
+	auto transpositionRe = std::regex("f([tf])");
+	auto keptRe = std::regex("z([abw])");
+	auto workRe = std::regex("w(\\d+)");
+	auto markerRe = std::regex("a([tf])");
+	auto numaRe = std::regex("u([tf])");
+	auto checkpointRe = std::regex("i(\\d+)");
+	auto externalRe = std::regex("xe(\\d+)");
+	auto distributedRe = std::regex("n(\\d+)/(\\d+)");
+	auto mergeRe = std::regex("g(\\d+)");
+	auto proofRe = std::regex("v(\\d+)");
+	auto telemetryRe = std::regex("j(\\d+)");
+	Telemetry telemetry(record, argv[1], [threads]() {
+		SearchStatistics total;
+		const auto num = threads->GetSize();
+		for (auto i = 0; i < num; i++) {
+			total.Merge(threads->Snapshots[i].Load());
+		}
+		return std::make_pair(num, total);
+	});
+	std::unique_ptr<DistributedStore<WinEval>> distributed;
 	while (true) {
 		cout << "Input: ";
 		string line;
@@ -117,7 +208,29 @@ int main(int argc, char* argv[]) {
 		} else if (line.compare("r") == 0 || line.compare(" ") == 0) {
 			cout << "Current Cut-off start step: " << int(startCutOffFinishedStep) << endl;
 			cout << "Current Minimax start step: " << int(startMiniMaxFinishedStep) << endl;
+			cout << "Current alpha-beta split depth: " << int(splitDepth) << endl;
+			cout << "Current extended keys: " << (extendedKeys ? "on" : "off") << endl;
+			cout << "Current enhanced transposition cut-off: " << (enhancedCutOff ? "on" : "off") << endl;
+			cout << "Current stored positions: " << (keptRecords == KeptRecords::All ? "all" : keptRecords == KeptRecords::BlackWins ? "black wins" : "white wins") << endl;
+			cout << "Current checkpoint interval: " << record.CheckpointInterval() << " s" << endl;
+			cout << "Current telemetry interval: " << telemetry.Interval() << " s" << endl;
+			const auto accesses = Numa::Accesses();
+			cout << "Current NUMA nodes: " << Numa::NodeCount() << ", pinning: " << (numaPinning ? "on" : "off") << ", sharded store accesses local/remote/unpinned: " << std::get<0>(accesses) << "/" << std::get<1>(accesses) << "/" << std::get<2>(accesses) << endl;
+			cout << "Current progress markers: " << (record.MarkersEnabled() ? "on" : "off") << endl;
+			cout << "Current work split depth: " << int(workSplitDepth) << ", queued sub trees: " << threads->Scheduler.Queued() << endl;
+			cout << "Current suspended searchers: " << threads->Suspended.Size() << endl;
+			if (distributed != nullptr) {
+				distributed->Report();
+			}
+			cout << "Current leaf solver: " << (leafSolver == LeafSolver::AlphaBeta ? "alpha-beta" : "proof-number (table capacity " + std::to_string(proofTableCapacity) + ")") << endl;
 			record.Report();
+			SearchStatistics total;
+			for (auto i = 0; i < threads->GetSize(); i++) {
+				const auto statistics = threads->Snapshots[i].Load();
+				statistics.Print("Thread " + std::to_string(i + 1));
+				total.Merge(statistics);
+			}
+			total.Print("All threads");
 		} else if (line.compare("s") == 0) {
 			if (!paused) {
 				SearchPrint::Illegal();
@@ -126,6 +239,22 @@ int main(int argc, char* argv[]) {
 			}
 		} else if (line.compare("d") == 0) {
 			record.Deserialize();
+		} else if (line.compare("x") == 0) {
+			if (!paused) {
+				SearchPrint::Illegal();
+			} else {
+				RetrogradeSolver solver(argv[1], thread::hardware_concurrency());
+				solver.Run(INITIAL_FINISHED_STEP, EMPTY_BOARD, EMPTY_BOARD);
+			}
+		} else if (std::regex_search(line, m, externalRe)) {
+			if (!paused) {
+				SearchPrint::Illegal();
+			} else {
+				LayerEnumerator enumerator(argv[1], static_cast<size_t>(std::stoull(m.str(1))) << 20, thread::hardware_concurrency());
+				enumerator.Enumerate(INITIAL_FINISHED_STEP, EMPTY_BOARD, EMPTY_BOARD);
+				RetrogradeSolver solver(argv[1], thread::hardware_concurrency());
+				solver.Solve(INITIAL_FINISHED_STEP);
+			}
 		} else if (std::regex_search(line, m, serializeRe)) {
 			auto step = std::stoi(m.str(1));
 			auto sw = m.str(2).compare("t") == 0;
@@ -162,6 +291,110 @@ int main(int argc, char* argv[]) {
 				startCutOffFinishedStep = newStartStep;
 				cout << "Change cut-off start step to " << int(startCutOffFinishedStep) << endl;
 			}
+		} else if (std::regex_search(line, m, splitRe)) {
+			auto newSplitDepth = std::stoi(m.str(1));
+			if (newSplitDepth < 0 || newSplitDepth > MAX_STEP) {
+				SearchPrint::Illegal();
+			} else {
+				splitDepth = newSplitDepth;
+				cout << "Change alpha-beta split depth to " << int(splitDepth) << endl;
+			}
+		} else if (std::regex_search(line, m, keyRe)) {
+			if (!paused) {
+				SearchPrint::Illegal();
+			} else {
+				extendedKeys = m.str(1).compare("t") == 0;
+				cout << "Change extended keys to " << (extendedKeys ? "on" : "off") << endl;
+			}
+		} else if (std::regex_search(line, m, transpositionRe)) {
+			enhancedCutOff = m.str(1).compare("t") == 0;
+			cout << "Change enhanced transposition cut-off to " << (enhancedCutOff ? "on" : "off") << endl;
+		} else if (std::regex_search(line, m, keptRe)) {
+			if (!paused) {
+				SearchPrint::Illegal();
+			} else {
+				keptRecords = m.str(1).compare("a") == 0 ? KeptRecords::All : m.str(1).compare("b") == 0 ? KeptRecords::BlackWins : KeptRecords::WhiteWins;
+				cout << "Change stored positions to " << (keptRecords == KeptRecords::All ? "all" : keptRecords == KeptRecords::BlackWins ? "black wins" : "white wins") << endl;
+			}
+		} else if (std::regex_search(line, m, checkpointRe)) {
+			record.StartCheckpoint(std::stoi(m.str(1)));
+			cout << "Change checkpoint interval to " << record.CheckpointInterval() << " s" << endl;
+		} else if (std::regex_search(line, m, telemetryRe)) {
+			telemetry.Start(std::stoi(m.str(1)));
+			cout << "Change telemetry interval to " << telemetry.Interval() << " s" << endl;
+		} else if (std::regex_search(line, m, numaRe)) {
+			if (!paused) {
+				SearchPrint::Illegal();
+			} else {
+				numaPinning = m.str(1).compare("t") == 0;
+				cout << "Change NUMA pinning to " << (numaPinning ? "on" : "off") << endl;
+			}
+		} else if (std::regex_search(line, m, markerRe)) {
+			if (!paused) {
+				SearchPrint::Illegal();
+			} else {
+				record.EnableProgressMarkers(m.str(1).compare("t") == 0);
+				cout << "Change progress markers to " << (record.MarkersEnabled() ? "on" : "off") << endl;
+			}
+		} else if (std::regex_search(line, m, workRe)) {
+			auto newWorkSplitDepth = std::stoi(m.str(1));
+			if (!paused || newWorkSplitDepth < 0 || newWorkSplitDepth > MAX_STEP) {
+				SearchPrint::Illegal();
+			} else {
+				workSplitDepth = newWorkSplitDepth;
+				threads->Scheduler.Reset();
+				threads->Suspended.Clear();
+				if (distributed != nullptr) {
+					distributed->QueryStep = workSplitDepth;
+					distributed->Reset();
+				}
+				cout << "Change work split depth to " << int(workSplitDepth) << endl;
+			}
+		} else if (std::regex_search(line, m, distributedRe)) {
+			auto rank = std::stoi(m.str(1));
+			auto num = std::stoi(m.str(2));
+			if (!paused || distributed != nullptr || workSplitDepth == 0 || num < 1 || rank < 0 || rank >= num) {
+				SearchPrint::Illegal();
+			} else {
+				cout << "cache capacity: ";
+				size_t capacity = 0;
+				cin >> capacity;
+				distributed = std::make_unique<DistributedStore<WinEval>>(record, argv[1], rank, num, capacity);
+				distributed->QueryStep = workSplitDepth;
+				auto remote = distributed.get();
+				threads->Scheduler.Partition([remote](const SearchTask& task) { return remote->Owned(task.Key()); }, [remote]() { return remote->RootGate(); });
+				threads->Scheduler.Reset();
+				threads->Suspended.Clear();
+				cout << "Join distributed solve as process " << rank << " of " << num << endl;
+			}
+		} else if (std::regex_search(line, m, mergeRe)) {
+			if (!paused) {
+				SearchPrint::Illegal();
+			} else {
+				DistributedStore<WinEval>::Merge(argv[1], std::stoi(m.str(1)));
+			}
+		} else if (std::regex_search(line, m, proofRe)) {
+			auto end = std::stoi(m.str(1));
+			if (!paused || end <= INITIAL_FINISHED_STEP || end > MAX_STEP) {
+				SearchPrint::Illegal();
+			} else {
+				cout << "size limit: ";
+				int limit = 0;
+				cin >> limit;
+				BestConverter::ExtractProofTree([&](const Step finishedStep, const Board board, WinEval& evaluation) { return record.Get(finishedStep, board, evaluation); }, INITIAL_FINISHED_STEP, end, { EMPTY_BOARD }, limit);
+			}
+		} else if (std::regex_search(line, m, leafRe)) {
+			if (!paused) {
+				SearchPrint::Illegal();
+			} else if (m.str(1).compare("p") == 0) {
+				cout << "table capacity: ";
+				cin >> proofTableCapacity;
+				leafSolver = LeafSolver::ProofNumber;
+				cout << "Change leaf solver to proof-number" << endl;
+			} else {
+				leafSolver = LeafSolver::AlphaBeta;
+				cout << "Change leaf solver to alpha-beta" << endl;
+			}
 		} else if (std::regex_search(line, m, backendRe)) {
 			if (!paused) {
 				SearchPrint::Illegal();
@@ -169,6 +402,10 @@ int main(int argc, char* argv[]) {
 				auto step = std::stoi(m.str(1));
 				if (m.str(2).compare("m") == 0) {
 					record.SwitchBackend(step, std::make_shared<MemoryRecordStorage<WinEval>>());
+				} else if (m.str(2).compare("n") == 0) {
+					record.SwitchBackend(step, std::make_shared<NumaRecordStorage<WinEval>>());
+				} else if (m.str(2).compare("p") == 0) {
+					record.SwitchBackend(step, std::make_shared<PackedRecordStorage<WinEval>>());
 				} else if (m.str(2).compare("c") == 0) {
 					cout << "cache capacity: ";
 					long capacity = 0;
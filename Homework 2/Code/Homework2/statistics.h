@@ -0,0 +1,175 @@
+//Name: Zongjian Li, USC ID: 6503378943
+#pragma once
+
+#include <cmath>
+#include <iomanip>
+
+#include "go.h"
+
+const static size_t STATISTICS_PLIES = TOTAL_POSITIONS + 1;
+
+class SearchStatistics {
+public:
+	UINT64 Nodes = 0;
+	array<UINT64, STATISTICS_PLIES> NodesPerPly;
+	UINT64 CutNodes = 0;
+	UINT64 FirstMoveCuts = 0;
+	UINT64 KoBlockedStores = 0;
+	UINT64 TwoPassTerminations = 0;
+	UINT64 DeferredBusy = 0;
+	UINT64 StoreProbes = 0;
+	UINT64 StoreHits = 0;
+	double Seconds = 0;
+
+	SearchStatistics() {
+		NodesPerPly.fill(0);
+	}
+
+	inline void Node(const int ply) {
+		Nodes++;
+		NodesPerPly[std::min(static_cast<size_t>(ply), STATISTICS_PLIES - 1)]++;
+	}
+
+	inline void Probe(const bool hit) {
+		StoreProbes++;
+		StoreHits += hit;
+	}
+
+	inline void Cut(const bool firstMove) {
+		CutNodes++;
+		FirstMoveCuts += firstMove;
+	}
+
+	//ply offset is used when the other search starts deeper
+	void Merge(const SearchStatistics& other, const size_t plyOffset = 0) {
+		Nodes += other.Nodes;
+		for (size_t i = 0; i < STATISTICS_PLIES; i++) {
+			NodesPerPly[std::min(i + plyOffset, STATISTICS_PLIES - 1)] += other.NodesPerPly[i];
+		}
+		CutNodes += other.CutNodes;
+		FirstMoveCuts += other.FirstMoveCuts;
+		KoBlockedStores += other.KoBlockedStores;
+		TwoPassTerminations += other.TwoPassTerminations;
+		DeferredBusy += other.DeferredBusy;
+		StoreProbes += other.StoreProbes;
+		StoreHits += other.StoreHits;
+		Seconds = std::max(Seconds, other.Seconds);//threads run at the same time
+	}
+
+	double NodesPerSecond() const {
+		return Seconds > 0 ? Nodes / Seconds : 0;
+	}
+
+	//b in N = b^d, d is the deepest ply reached
+	double EffectiveBranchingFactor() const {
+		size_t deepest = 0;
+		for (size_t i = 0; i < STATISTICS_PLIES; i++) {
+			if (NodesPerPly[i] > 0) {
+				deepest = i;
+			}
+		}
+		return deepest == 0 ? 0 : std::pow(static_cast<double>(Nodes), 1.0 / deepest);
+	}
+
+	double FirstMoveCutRate() const {
+		return CutNodes == 0 ? 0 : static_cast<double>(FirstMoveCuts) / CutNodes;
+	}
+
+	double HitRate() const {
+		return StoreProbes == 0 ? 0 : static_cast<double>(StoreHits) / StoreProbes;
+	}
+
+	void Print(const string& title) const {
+		cout << title << ":" << endl;
+		cout << "\t" << "nodes: " << Nodes << " in " << std::setprecision(3) << Seconds << " s, " << static_cast<UINT64>(NodesPerSecond()) << " nodes/s" << endl;
+		cout << "\t" << "nodes per ply:";
+		for (size_t i = 0; i < STATISTICS_PLIES; i++) {
+			if (NodesPerPly[i] > 0) {
+				cout << " " << i << ":" << NodesPerPly[i];
+			}
+		}
+		cout << endl;
+		cout << "\t" << "effective branching factor: " << std::setprecision(3) << EffectiveBranchingFactor() << endl;
+		cout << "\t" << "cut nodes: " << CutNodes << ", first move cut rate: " << std::setprecision(3) << FirstMoveCutRate() << endl;
+		cout << "\t" << "ko blocked stores: " << KoBlockedStores << ", two pass terminations: " << TwoPassTerminations << endl;
+		cout << "\t" << "deferred positions being searched by other threads: " << DeferredBusy << endl;
+		cout << "\t" << "store probes: " << StoreProbes << ", hits: " << StoreHits << ", hit rate: " << std::setprecision(3) << HitRate() << endl;
+	}
+};
+
+//each thread counts into its own slot without locking, slots are merged only after the search
+class StatisticsCollector {
+private:
+	const UINT64 id;
+	mutable std::mutex mutex;
+	vector<pair<std::thread::id, std::unique_ptr<SearchStatistics>>> slots;
+
+	static UINT64 NextId() {
+		static atomic<UINT64> next(1);
+		return next.fetch_add(1);
+	}
+public:
+	StatisticsCollector() : id(NextId()) {}
+
+	SearchStatistics& Local() {
+		thread_local UINT64 owner = 0;//collectors may reuse the address of a destroyed one, so compare ids
+		thread_local SearchStatistics* slot = nullptr;
+		if (owner != id) {//only when a thread switches between searchers
+			std::lock_guard<std::mutex> lock(mutex);
+			const auto self = std::this_thread::get_id();
+			slot = nullptr;
+			for (const auto& s : slots) {
+				if (s.first == self) {
+					slot = s.second.get();
+				}
+			}
+			if (slot == nullptr) {
+				slots.emplace_back(self, std::unique_ptr<SearchStatistics>(new SearchStatistics()));
+				slot = slots.back().second.get();
+			}
+			owner = id;
+		}
+		return *slot;
+	}
+
+	vector<SearchStatistics> PerThread() const {
+		std::lock_guard<std::mutex> lock(mutex);
+		vector<SearchStatistics> result;
+		for (const auto& s : slots) {
+			result.push_back(*s.second);
+		}
+		return result;
+	}
+
+	SearchStatistics Merged() const {
+		SearchStatistics result;
+		for (const auto& s : PerThread()) {
+			result.Merge(s);
+		}
+		return result;
+	}
+
+	void Clear() {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& s : slots) {
+			*s.second = SearchStatistics();
+		}
+	}
+};
+
+//a copy for readers on other threads, updated from time to time by the searching thread
+class StatisticsSnapshot {
+private:
+	mutable std::mutex mutex;
+	SearchStatistics value;
+public:
+	void Store(const SearchStatistics& statistics) {
+		std::lock_guard<std::mutex> lock(mutex);
+		value = statistics;
+	}
+
+	SearchStatistics Load() const {
+		std::lock_guard<std::mutex> lock(mutex);
+		return value;
+	}
+};
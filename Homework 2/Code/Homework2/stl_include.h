@@ -7,7 +7,14 @@
 #ifdef _MSC_VER
 //gcc compiler <immintrin.h> support not enabled on the test platform
 #include <immintrin.h>
+#include <intrin.h>
 #define __builtin_popcountll _mm_popcnt_u64
+
+inline int __builtin_ctzll(const unsigned long long value) {//undefined for 0 as in gcc
+	unsigned long index;
+	_BitScanForward64(&index, value);
+	return static_cast<int>(index);
+}
 #endif
 
 #ifdef _MSC_VER
@@ -22,6 +29,8 @@
 #include <queue>
 #include <random>
 #include <map>
+#include <set>
+#include <unordered_map>
 #include <string>
 #include <iostream>
 #include <fstream>
@@ -29,6 +38,7 @@
 #include <thread>
 #include <vector>
 #include <cstdlib>
+#include <cstring>
 #include <atomic>
 #include <iostream>
 #include <regex>
@@ -40,6 +50,7 @@ using std::endl;
 using std::string;
 using std::array;
 using std::map;
+using std::set;
 using std::string;
 using std::ifstream;
 using std::ofstream;
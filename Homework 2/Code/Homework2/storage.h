@@ -55,6 +55,69 @@ protected:
 	atomic<UINT64> total_query = 0;
 #endif
 
+	//records set since the last checkpoint, sharded so that searching threads rarely wait for each other
+	const static size_t LOG_SHARD_BITS = 4;
+
+	class LogShard {
+	public:
+		std::mutex Mutex;
+		vector<std::pair<Board, E>> Records;
+	};
+
+	array<LogShard, 1 << LOG_SHARD_BITS> pending;
+	atomic<bool> logging{ false };
+	std::mutex checkpoint;//one checkpoint or serialization at a time, searching threads are not blocked
+
+	inline static string LogFilename(const string& filename) {
+		return filename + ".log";
+	}
+
+	inline static string TempFilename(const string& filename) {
+		return filename + ".tmp";
+	}
+
+	vector<std::pair<Board, E>> take_pending() {
+		vector<std::pair<Board, E>> result;
+		for (auto& shard : pending) {
+			std::lock_guard<std::mutex> l(shard.Mutex);
+			result.insert(result.end(), shard.Records.begin(), shard.Records.end());
+			vector<std::pair<Board, E>>().swap(shard.Records);
+		}
+		return result;
+	}
+
+	UINT64 flush(const string& filename) {
+		const auto records = take_pending();
+		if (records.empty()) {
+			return 0;
+		}
+		ofstream file(LogFilename(filename), std::ios::binary | std::ios::app);
+		assert(file.is_open());
+		for (const auto& record : records) {
+			write_record(file, record.first, record.second);
+		}
+		file.close();
+		return records.size();
+	}
+
+	//a record torn by a crash at the end of the log is dropped
+	UINT64 replay(const string& filename) {
+		ifstream file(LogFilename(filename), std::ios::binary);
+		if (!file.is_open()) {
+			return 0;
+		}
+		UINT64 count = 0;
+		while (true) {
+			const auto record = read_record(file);
+			if (!file) {
+				break;
+			}
+			safe_insert(record.first, record.second);
+			count++;
+		}
+		return count;
+	}
+
 public:
 	bool EnableSerialize = true;
 
@@ -62,10 +125,16 @@ public:
 
 	virtual size_t size() const = 0;
 
+	//rough memory of one entry including the container overhead
+	virtual size_t EntryBytes() const {
+		return sizeof(Board) + sizeof(E);
+	}
+
 	void Serialize(const string& filename) {
 		if (!EnableSerialize) {
 			return;
 		}
+		std::lock_guard<std::mutex> c(checkpoint);
 		std::unique_lock<recursive_mutex> l(lock);
 		unsigned long long s = size();
 		if (s == 0) {
@@ -76,27 +145,85 @@ public:
 		serialize(file);
 		file.close();
 		assert(!file.fail());
+		take_pending();//all in the full file now
+		std::remove(LogFilename(filename).c_str());
 		cout << "Serialized " << filename << " with " << s << " entries" << endl;
 	}
 
+	//full file and then the delta log, a complete temporary file is used if a compaction crashed before renaming
 	void Deserialize(const string& filename) {
 		if (!EnableSerialize) {
 			return;
 		}
+		std::lock_guard<std::mutex> c(checkpoint);
 		ifstream file(filename, std::ios::binary);
 		if (!file.is_open()) {
-			cout << filename << " not found, skip deserialization" << endl;
-			return;
+			file.open(TempFilename(filename), std::ios::binary);
 		}
 		std::unique_lock<recursive_mutex> l(lock);
-		deserialize(file);
+		if (!file.is_open()) {
+			cout << filename << " not found, skip deserialization" << endl;
+		} else {
+			deserialize(file);
+			file.close();
+			assert(!file.fail());
+			cout << "Deserialized " << size() << " entries from " << filename << endl;
+		}
+		const auto replayed = replay(filename);
+		if (replayed > 0) {
+			cout << "Replayed " << replayed << " entries from " << LogFilename(filename) << endl;
+		}
+	}
+
+	//keep new records for the delta log
+	void EnableLog(const bool flag) {
+		logging = flag;
+	}
+
+	bool LogEnabled() const {
+		return logging;
+	}
+
+	//append records set since the last checkpoint to the delta log, return number of records
+	UINT64 Flush(const string& filename) {
+		if (!EnableSerialize) {
+			return 0;
+		}
+		std::lock_guard<std::mutex> c(checkpoint);
+		return flush(filename);
+	}
+
+	//flush, write the full file while searching goes on, then drop the log, records set meanwhile stay pending
+	//the record count is patched after writing, because the size changes during the iteration
+	UINT64 Compact(const string& filename) {
+		if (!EnableSerialize) {
+			return 0;
+		}
+		std::lock_guard<std::mutex> c(checkpoint);
+		const auto flushed = flush(filename);
+		if (Type() != RecordStorageType::Memory || size() == 0) {//other backends do not keep all records
+			return flushed;
+		}
+#ifndef SEARCH_MODE
+		std::unique_lock<recursive_mutex> l(lock);//std::map is not safe to iterate while other threads insert
+#endif
+		const auto temp = TempFilename(filename);
+		ofstream file(temp, std::ios::binary);
+		assert(file.is_open());
+		serialize(file);
+		const UINT64 count = (static_cast<UINT64>(file.tellp()) - sizeof(UINT64)) / (sizeof(Board) + sizeof(E));
+		file.seekp(0);
+		write_size(file, count);
 		file.close();
 		assert(!file.fail());
-		cout << "Deserialized " << size() << " entries from " << filename << endl;
+		std::remove(filename.c_str());
+		std::rename(temp.c_str(), filename.c_str());
+		std::remove(LogFilename(filename).c_str());
+		return flushed;
 	}
 
-	void Set(const Board board, const E& record) {
-		auto standardBoard = Isomorphism(board).StandardBoard();
+	void Set(const Board board, const E& record) {//board may be an extended position key
+		auto standardBoard = PositionKey::Standard(board);
 #ifdef _DEBUG
 		E temp;
 		if (safe_lookup(standardBoard, temp)) {
@@ -104,6 +231,11 @@ public:
 		}
 #endif
 		safe_insert(standardBoard, record);
+		if (logging.load(std::memory_order_relaxed)) {
+			auto& shard = pending[(standardBoard * 0x9E3779B97F4A7C15ull) >> (64 - LOG_SHARD_BITS)];
+			std::lock_guard<std::mutex> l(shard.Mutex);
+			shard.Records.emplace_back(standardBoard, record);
+		}
 	}
 
 	bool Get(const Board board, E& record) {
@@ -119,7 +251,7 @@ public:
 #ifdef COLLECT_STORAGE_HIT_RATE
 		total_query++;
 #endif
-		auto standardBoard = Isomorphism(board).StandardBoard();
+		auto standardBoard = PositionKey::Standard(board);
 		auto found = safe_lookup(standardBoard, record);
 		if (!found) {
 			return false;
@@ -224,6 +356,9 @@ protected:
 	}
 
 	bool safe_lookup(const Board standardBoard, E& record) const override {
+#ifdef PARALLEL_ALPHA_BETA
+		std::unique_lock<recursive_mutex> parallel(this->lock);//std::map is not safe to read while other tasks insert
+#endif
 		auto find = m.find(standardBoard);
 		if (find == m.end()) {
 			std::unique_lock<recursive_mutex> l(this->lock);
@@ -258,6 +393,10 @@ public:
 		return m.size();
 	}
 
+	size_t EntryBytes() const override {//red-black tree node
+		return 4 * sizeof(void*) + sizeof(pair<Board, E>);
+	}
+
 	void clear() override {
 		std::unique_lock<recursive_mutex> l(this->lock);
 		m.clear();
@@ -313,6 +452,10 @@ public:
 		return m.size();
 	}
 
+	size_t EntryBytes() const override {//skip list node of 2 levels on average
+		return 3 * sizeof(void*) + sizeof(pair<Board, E>);
+	}
+
 	void clear() override {
 		std::unique_lock<recursive_mutex> l(this->lock);
 		m.clear();
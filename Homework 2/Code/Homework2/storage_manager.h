@@ -7,15 +7,102 @@
 #include <iomanip>
 #endif
 
+//standard keys of positions being searched by some thread, a thread reaching one of them can search other siblings first (ABDADA)
+class ProgressMarkers {
+private:
+	const static size_t SHARD_BITS = 6;
+
+	class Shard {
+	public:
+		std::mutex Mutex;
+		std::unordered_map<Board, int> Counts;
+	};
+
+	array<Shard, 1 << SHARD_BITS> shards;
+
+	inline Shard& Of(const Board key) {
+		return shards[(key * 0x9E3779B97F4A7C15ull) >> (64 - SHARD_BITS)];
+	}
+public:
+	void Enter(const Board key) {
+		auto& shard = Of(key);
+		std::lock_guard<std::mutex> l(shard.Mutex);
+		shard.Counts[key]++;
+	}
+
+	void Leave(const Board key) {
+		auto& shard = Of(key);
+		std::lock_guard<std::mutex> l(shard.Mutex);
+		const auto iter = shard.Counts.find(key);
+		assert(iter != shard.Counts.end());
+		if (--iter->second == 0) {
+			shard.Counts.erase(iter);
+		}
+	}
+
+	bool Busy(const Board key) {
+		auto& shard = Of(key);
+		std::lock_guard<std::mutex> l(shard.Mutex);
+		return shard.Counts.find(key) != shard.Counts.end();
+	}
+};
+
+#ifdef SEARCH_MODE
+//records owned by other processes, see distributed.h, keys are standard keys
+template <typename E>
+class RemoteRecords {
+public:
+	virtual ~RemoteRecords() = default;
+
+	virtual bool Owned(const Board standardKey) const = 0;
+	virtual bool Get(const Step finishedStep, const Board standardKey, E& record) = 0;
+	virtual void Set(const Step finishedStep, const Board standardKey, const E& record) = 0;
+};
+#endif
+
 template <typename E>
 class StorageManager {
 private:
 	const string FilenamePrefix;
 	array<std::shared_ptr<RecordStorage<E>>, MAX_STEP + 1> Stores;
+	array<ProgressMarkers, MAX_STEP + 1> Markers;
+	bool EnableMarkers = false;
+#ifdef SEARCH_MODE
+	const static UINT64 CHECKPOINTS_PER_COMPACTION = 16;
+	std::unique_ptr<thread> Checkpointer;
+	atomic<bool> CheckpointStop{ false };
+	int CheckpointSeconds = 0;
+	RemoteRecords<E>* Remote = nullptr;
+	mutable std::mutex WorldMutex;//held while stores are replaced, cleared or reloaded, so the telemetry thread never reads one meanwhile
+	string PartitionName;//part of file names, so processes of a distributed solve do not overwrite each other
+
+	//delta logs are flushed every few seconds and compacted into full files from time to time, flushed once more when stopped
+	void CheckpointLoop(const int seconds) {
+		for (UINT64 round = 1; ; round++) {
+			for (auto i = 0; i < seconds * 10 && !CheckpointStop; i++) {
+				std::this_thread::sleep_for(milliseconds(100));
+			}
+			const bool stop = CheckpointStop;
+			const auto compact = !stop && round % CHECKPOINTS_PER_COMPACTION == 0;
+			UINT64 count = 0;
+			for (auto i = 0; i <= MAX_STEP; i++) {
+				count += compact ? Stores[i]->Compact(Filename(i)) : Stores[i]->Flush(Filename(i));
+			}
+			cout << "Checkpoint: " << count << " new entries logged" << (compact ? ", compacted" : "") << endl;
+			if (stop) {
+				break;
+			}
+		}
+	}
+#endif
 
 	string Filename(const Step step) {
 		assert(0 <= step && step <= MAX_STEP);
+#ifdef SEARCH_MODE
+		return FilenamePrefix + PartitionName + std::to_string(step);
+#else
 		return FilenamePrefix + std::to_string(step);
+#endif
 	}
 
 public:
@@ -26,6 +113,44 @@ public:
 		}
 	}
 
+#ifdef SEARCH_MODE
+	~StorageManager() {
+		StartCheckpoint(0);
+	}
+
+	//checkpoint every given seconds while searching, 0 to stop
+	void StartCheckpoint(const int seconds) {
+		if (Checkpointer != nullptr) {
+			if (seconds == 0) {//nothing is left behind the last flush, a new interval keeps logging, so no record misses the log meanwhile
+				for (auto& store : Stores) {
+					store->EnableLog(false);
+				}
+			}
+			CheckpointStop = true;
+			Checkpointer->join();
+			Checkpointer = nullptr;
+		}
+		CheckpointSeconds = seconds;
+		for (auto& store : Stores) {
+			store->EnableLog(seconds > 0);
+		}
+		if (seconds > 0) {
+			CheckpointStop = false;
+			Checkpointer = std::make_unique<thread>(&StorageManager::CheckpointLoop, this, seconds);
+		}
+	}
+
+	int CheckpointInterval() const {
+		return CheckpointSeconds;
+	}
+
+	//only positions owned by this process are kept in the stores, others are passed to remote, must stop the world
+	void Distribute(RemoteRecords<E>* remote, const string& partitionName) {
+		Remote = remote;
+		PartitionName = partitionName;
+	}
+#endif
+
 	void Serialize() {
 #ifdef SEARCH_MODE
 		array<std::unique_ptr<thread>, MAX_STEP + 1> threads;
@@ -44,13 +169,19 @@ public:
 
 	void Deserialize() {
 #ifdef SEARCH_MODE
-		array<std::unique_ptr<thread>, MAX_STEP + 1> threads;
-		for (auto i = 0; i < MAX_STEP + 1; i++) {
-			threads[i] = std::make_unique<thread>(&RecordStorage<E>::Deserialize, Stores[i], Filename(i));
-		}
-		for (auto& t : threads) {
-			t->join();
+		const auto seconds = CheckpointSeconds;
+		StartCheckpoint(0);//a compaction must not iterate or write a half loaded store
+		{
+			std::lock_guard<std::mutex> world(WorldMutex);
+			array<std::unique_ptr<thread>, MAX_STEP + 1> threads;
+			for (auto i = 0; i < MAX_STEP + 1; i++) {
+				threads[i] = std::make_unique<thread>(&RecordStorage<E>::Deserialize, Stores[i], Filename(i));
+			}
+			for (auto& t : threads) {
+				t->join();
+			}
 		}
+		StartCheckpoint(seconds);
 #else
 		for (auto i = 0; i <= MAX_STEP; i++) {
 			Stores[i]->Deserialize(Filename(i));
@@ -59,13 +190,89 @@ public:
 	}
 
 	inline bool Get(const Step finishedStep, const Board board, E& record) {
+#ifdef SEARCH_MODE
+		if (Remote != nullptr) {
+			const auto standardKey = PositionKey::Standard(board);
+			if (!Remote->Owned(standardKey)) {
+				return Remote->Get(finishedStep, standardKey, record);
+			}
+		}
+#endif
 		return Stores[finishedStep]->Get(board, record);
 	}
 
 	inline void Set(const Step finishedStep, const Board board, const E& record) {
+#ifdef SEARCH_MODE
+		if (Remote != nullptr) {
+			const auto standardKey = PositionKey::Standard(board);
+			if (!Remote->Owned(standardKey)) {
+				Remote->Set(finishedStep, standardKey, record);
+				return;
+			}
+		}
+#endif
 		Stores[finishedStep]->Set(board, record);
 	}
 
+	//markers are keyed by standard keys, the caller standardizes once for all 3 calls
+	inline bool MarkersEnabled() const {
+		return EnableMarkers;
+	}
+
+	void EnableProgressMarkers(const bool flag) {// must stop the world
+		EnableMarkers = flag;
+	}
+
+	inline void Enter(const Step finishedStep, const Board standardKey) {
+		Markers[finishedStep].Enter(standardKey);
+	}
+
+	inline void Leave(const Step finishedStep, const Board standardKey) {
+		Markers[finishedStep].Leave(standardKey);
+	}
+
+	inline bool Busy(const Step finishedStep, const Board standardKey) {
+		return Markers[finishedStep].Busy(standardKey);
+	}
+
+	//look up positions of the same step together, return number of hits
+	size_t GetBatch(const Step finishedStep, const vector<Board>& boards, vector<E>& records, vector<bool>& hits) {
+		auto& store = *Stores[finishedStep];
+		records.resize(boards.size());
+		hits.resize(boards.size());
+		size_t count = 0;
+		for (size_t i = 0; i < boards.size(); i++) {
+#ifdef SEARCH_MODE
+			hits[i] = Remote != nullptr ? Get(finishedStep, boards[i], records[i]) : store.Get(boards[i], records[i]);
+#else
+			hits[i] = store.Get(boards[i], records[i]);
+#endif
+			count += hits[i];
+		}
+		return count;
+	}
+
+#ifdef SEARCH_MODE
+	//the ones below may be called by other threads while searching
+	size_t Size(const Step finishedStep) const {
+		std::lock_guard<std::mutex> world(WorldMutex);
+		return Stores[finishedStep]->size();
+	}
+
+	UINT64 EstimatedBytes(const Step finishedStep) const {
+		std::lock_guard<std::mutex> world(WorldMutex);
+		const auto& store = *Stores[finishedStep];
+		return static_cast<UINT64>(store.size()) * store.EntryBytes();
+	}
+
+#ifdef COLLECT_STORAGE_HIT_RATE
+	double HitRate(const Step finishedStep) const {
+		std::lock_guard<std::mutex> world(WorldMutex);
+		return Stores[finishedStep]->HitRate();
+	}
+#endif
+#endif
+
 #if defined(SEARCH_MODE) || defined(INTERACT_MODE)
 	void Report() const {
 		cout << "Report:" << endl;
@@ -96,7 +303,17 @@ public:
 #endif
 
 	void Clear(const Step finishedStep) {// must stop the world
+#ifdef SEARCH_MODE
+		const auto seconds = CheckpointSeconds;
+		StartCheckpoint(0);//the checkpoint thread is part of the world
+		{
+			std::lock_guard<std::mutex> world(WorldMutex);
+			Stores[finishedStep]->Clear();
+		}
+		StartCheckpoint(seconds);
+#else
 		Stores[finishedStep]->Clear();
+#endif
 	}
 
 	void ClearAll() {
@@ -115,12 +332,21 @@ public:
 
 	void SwitchBackend(const Step step, std::shared_ptr<RecordStorage<E>>&& newBackend) {// must stop the world
 		assert(newBackend != nullptr);
+#ifdef SEARCH_MODE
+		const auto seconds = CheckpointSeconds;
+		StartCheckpoint(0);//the checkpoint thread is part of the world
+		std::unique_lock<std::mutex> world(WorldMutex);
+#endif
 		auto& store = Stores[step];
 		cout << "Switching backend" << endl;
 		auto filename = Filename(step);
 		store->Serialize(filename);
 		store = newBackend;
 		store->Deserialize(filename);
+#ifdef SEARCH_MODE
+		world.unlock();
+		StartCheckpoint(seconds);
+#endif
 	}
 
 #ifdef COLLECT_STORAGE_HIT_RATE
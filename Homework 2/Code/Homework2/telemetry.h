@@ -0,0 +1,120 @@
+//Name: Zongjian Li, USC ID: 6503378943
+#pragma once
+
+#include <functional>
+#include <sstream>
+
+#include "storage_manager.h"
+#include "statistics.h"
+
+//one JSON object per line is appended to a file every period, so a long run can be watched and plotted by other tools
+//only store sizes and the statistics snapshots of the report are read, searching threads do no extra work
+class Telemetry {
+public:
+	using Sampler = std::function<pair<int, SearchStatistics>()>;//active threads and their merged statistics
+private:
+	StorageManager<WinEval>& store;
+	const string filename;
+	const string censusFilename;
+	const Sampler sampler;
+	std::unique_ptr<thread> worker;
+	atomic<bool> stop{ false };
+	int intervalSeconds = 0;
+
+	//layer sizes written by the enumerator, 0 if unknown
+	array<UINT64, MAX_STEP + 1> ReadCensus() const {
+		array<UINT64, MAX_STEP + 1> census;
+		census.fill(0);
+		ifstream file(censusFilename);
+		int step;
+		UINT64 size;
+		while (file >> step >> size) {
+			if (0 <= step && step <= MAX_STEP) {
+				census[step] = size;
+			}
+		}
+		return census;
+	}
+
+	static string Number(const double value) {//JSON has no NaN or infinity
+		if (!std::isfinite(value)) {
+			return "null";
+		}
+		std::ostringstream s;
+		s << std::setprecision(6) << value;
+		return s.str();
+	}
+
+	void Loop(const int period) {
+		const auto census = ReadCensus();
+		const auto start = high_resolution_clock::now();
+		auto last = start;
+		auto lastNodes = sampler().second.Nodes;
+		array<size_t, MAX_STEP + 1> lastSizes;
+		for (auto i = 0; i <= MAX_STEP; i++) {
+			lastSizes[i] = store.Size(i);
+		}
+		while (true) {
+			for (auto i = 0; i < period * 10 && !stop; i++) {
+				std::this_thread::sleep_for(milliseconds(100));
+			}
+			if (stop) {
+				break;
+			}
+			const auto now = high_resolution_clock::now();
+			const auto interval = duration_cast<milliseconds>(now - last).count() / 1000.0;
+			const auto sample = sampler();
+			const auto& statistics = sample.second;
+			std::ostringstream line;
+			line << "{\"time\":" << std::chrono::duration_cast<seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+			line << ",\"elapsed\":" << Number(duration_cast<milliseconds>(now - start).count() / 1000.0);
+			line << ",\"threads\":" << sample.first;
+			line << ",\"nodes\":" << statistics.Nodes;
+			line << ",\"nodes_per_second\":" << Number(statistics.Nodes >= lastNodes ? (statistics.Nodes - lastNodes) / interval : 0);//searchers recreated start from 0
+			line << ",\"hit_rate\":" << Number(statistics.StoreProbes == 0 ? NAN : statistics.HitRate());
+			line << ",\"steps\":[";
+			for (auto i = 0; i <= MAX_STEP; i++) {
+				const auto size = store.Size(i);
+				const auto rate = (static_cast<double>(size) - lastSizes[i]) / interval;
+				const auto eta = census[i] > size && rate > 0 ? (census[i] - size) / rate : census[i] > 0 && census[i] <= size ? 0 : NAN;
+				line << (i == 0 ? "" : ",") << "{\"step\":" << i << ",\"size\":" << size << ",\"bytes\":" << store.EstimatedBytes(i) << ",\"stored_per_second\":" << Number(rate);
+#ifdef COLLECT_STORAGE_HIT_RATE
+				line << ",\"hit_rate\":" << Number(store.HitRate(i));
+#endif
+				line << ",\"eta\":" << Number(eta) << "}";
+				lastSizes[i] = size;
+			}
+			line << "]}";
+			ofstream file(filename, std::ios::app);//closed every time, so the file is complete while the search runs
+			file << line.str() << endl;
+			file.close();
+			last = now;
+			lastNodes = statistics.Nodes;
+		}
+	}
+public:
+	//the eta of a step needs its size in the census written by the enumerator
+	Telemetry(StorageManager<WinEval>& _store, const string& prefix, const Sampler& _sampler) : store(_store), filename(prefix + "telemetry.jsonl"), censusFilename(prefix + "census" + HELPER_FILE_EXTENSION), sampler(_sampler) {}
+
+	~Telemetry() {
+		Start(0);
+	}
+
+	//a line every given seconds, 0 to stop
+	void Start(const int period) {
+		if (worker != nullptr) {
+			stop = true;
+			worker->join();
+			worker = nullptr;
+		}
+		intervalSeconds = period;
+		if (period > 0) {
+			stop = false;
+			worker = std::unique_ptr<thread>(new thread(&Telemetry::Loop, this, period));
+		}
+	}
+
+	int Interval() const {
+		return intervalSeconds;
+	}
+};